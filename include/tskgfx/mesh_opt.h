@@ -0,0 +1,103 @@
+/**
+ * @file mesh_opt.h
+ * @brief This file contains the mesh optimization utilities.
+ *
+ * Reorders indices and vertices for the post-transform vertex cache, overdraw
+ * and vertex fetch. The functions only depend on the cpu and may be run
+ * offline or on mesh creation.
+ *
+ * @author Moka
+ * @date 2024-11-03
+ */
+
+#ifndef MESH_OPT_H_
+#define MESH_OPT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace tsk {
+
+constexpr uint32_t k_vertex_cache_size = 16;  // FIFO size used for analysis.
+
+/* @brief Post-transform vertex cache efficiency of an index buffer.*/
+struct VertexCacheStats {
+  uint32_t vertices_transformed;
+  float acmr;  //!< average vertices transformed per triangle, 0.5 at best.
+  float atvr;  //!< average transforms per referenced vertex, 1.0 at best.
+};
+
+/// @brief Finds binary identical vertices.
+///
+/// @param[out] remap Index of the unique vertex per vertex, unique vertices
+/// are numbered in order of first occurrence.
+/// @returns Number of unique vertices.
+uint32_t generate_vertex_remap(uint32_t* remap,
+                               const void* vertices,
+                               uint32_t vertex_count,
+                               size_t vertex_size);
+
+/// @brief Compacts vertices with a remap of generate_vertex_remap.
+void remap_vertices(void* dst,
+                    const void* vertices,
+                    uint32_t vertex_count,
+                    size_t vertex_size,
+                    const uint32_t* remap);
+
+/// @brief Remaps indices with a remap of generate_vertex_remap.
+///
+/// @note dst may be indices.
+void remap_indices(uint32_t* dst,
+                   const uint32_t* indices,
+                   size_t index_count,
+                   const uint32_t* remap);
+
+/// @brief Reorders triangles to reuse recently transformed vertices.
+///
+/// Greedy vertex cache optimization after Forsyth, scoring vertices by their
+/// position in a simulated LRU cache and remaining triangle valence.
+///
+/// @note dst may be indices.
+void optimize_vertex_cache(uint32_t* dst,
+                           const uint32_t* indices,
+                           size_t index_count,
+                           uint32_t vertex_count);
+
+/// @brief Reorders clusters of triangles so outward facing clusters are drawn
+/// first, reducing overdraw.
+///
+/// Clusters are split where the vertex cache restarts, threshold bounds the
+/// ACMR increase accepted to split them further, e.g. 1.05.
+///
+/// @param[in] indices Vertex cache optimized indices.
+/// @param[in] positions float3 positions, vertex_stride bytes apart.
+///
+/// @note dst may be indices.
+void optimize_overdraw(uint32_t* dst,
+                       const uint32_t* indices,
+                       size_t index_count,
+                       const float* positions,
+                       uint32_t vertex_count,
+                       size_t vertex_stride,
+                       float threshold);
+
+/// @brief Reorders vertices in the order indices first reference them and
+/// remaps the indices. Unreferenced vertices are dropped.
+///
+/// @returns Number of vertices written to dst.
+uint32_t optimize_vertex_fetch(void* dst,
+                               uint32_t* indices,
+                               size_t index_count,
+                               const void* vertices,
+                               uint32_t vertex_count,
+                               size_t vertex_size);
+
+/// @brief Simulates a FIFO vertex cache.
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices,
+                                      size_t index_count,
+                                      uint32_t vertex_count,
+                                      uint32_t cache_size = k_vertex_cache_size);
+
+}  // namespace tsk
+
+#endif
@@ -76,14 +76,23 @@ class TUSK_NO_VTABLE RenderContextI {
   virtual void shutdown() = 0;
   virtual void frame() = 0;
 
-  virtual void create_texture_2d(TextureHandle th, const TextureInfo& info) = 0;
-  virtual void update_texture_2d(TextureHandle th,
-                                 uint32_t offset,
-                                 uint32_t size,
-                                 void* data);
+  virtual void create_texture(TextureHandle th, const TextureInfo& info) = 0;
+  virtual void update_texture(TextureHandle th,
+                              uint32_t offset,
+                              uint32_t size,
+                              void* data) = 0;
+  virtual void update_texture_layers(TextureHandle th,
+                                     uint16_t first_layer,
+                                     uint16_t num_layers,
+                                     void* data) = 0;
   virtual void destroy(TextureHandle th) = 0;
 
-  virtual void create_shader(ShaderHandle sh, const char* path) = 0;
+  virtual void request_texture_lod(TextureHandle th, float lod) = 0;
+  virtual void request_texture_size(TextureHandle th, float screen_size) = 0;
+  virtual void set_texture_budget(uint64_t bytes) = 0;
+  virtual TextureStreamingStats get_texture_streaming_stats() = 0;
+
+  virtual ShaderHandle create_shader(ShaderHandle sh, const char* path) = 0;
   virtual void destroy(ShaderHandle sh) = 0;
 
   virtual void create_program(ProgramHandle ph, ShaderHandle csh) = 0;
@@ -91,11 +100,24 @@ class TUSK_NO_VTABLE RenderContextI {
                               ShaderHandle vsh,
                               ShaderHandle fsh) = 0;
   virtual void destroy(ProgramHandle ph) = 0;
+  virtual bool is_ready(ProgramHandle ph) = 0;
+  virtual void set_fallback_program(ProgramHandle ph) = 0;
+  virtual ProgramHandle create_program_variant(
+      ProgramHandle variant,
+      ProgramHandle ph,
+      const SpecializationConstant* constants,
+      uint32_t count) = 0;
+  virtual uint32_t get_specialization_constants(ProgramHandle ph,
+                                                uint32_t* ids) = 0;
 
   virtual void create_descriptor(DescriptorHandle dh,
                                  DescriptorType type,
                                  uint16_t rh,
+                                 const SamplerInfo& sampler,
                                  const char* name) = 0;
+  virtual void destroy(DescriptorHandle dh) = 0;
+
+  virtual uint32_t get_bindless_sampler(const SamplerInfo& sampler) = 0;
 
   virtual void create_uniform_buffer(BufferHandle bh,
                                      uint32_t size,
@@ -113,6 +135,31 @@ class TUSK_NO_VTABLE RenderContextI {
                              void* data) = 0;
   virtual void destroy(BufferHandle bh) = 0;
 
+  virtual bool create_mesh(MeshHandle mh,
+                           const void* vertices,
+                           uint32_t vertices_size,
+                           const uint32_t* indices,
+                           uint32_t index_count) = 0;
+  virtual void destroy(MeshHandle mh) = 0;
+
+  virtual void set_name(BufferHandle bh, const char* name) = 0;
+  virtual void set_name(TextureHandle th, const char* name) = 0;
+  virtual MemoryStats get_memory_stats() = 0;
+  virtual uint32_t get_resource_memory(ResourceMemoryInfo* infos,
+                                       uint32_t max_infos) = 0;
+  virtual void set_memory_warning_callback(MemoryWarningFn fn,
+                                           float threshold) = 0;
+
+  virtual void defragment(uint64_t max_bytes_per_frame,
+                          uint32_t max_moves_per_frame,
+                          float max_ms_per_frame) = 0;
+  virtual DefragmentationStats get_defragmentation_stats() = 0;
+
+  virtual DescriptorCacheStats get_descriptor_cache_stats() = 0;
+
+  virtual bool save_pipeline_cache() = 0;
+  virtual PipelineCacheStats get_pipeline_cache_stats() = 0;
+
   virtual void submit(Frame* frame) = 0;
 };
 
@@ -18,16 +18,61 @@
 #elif TUSK_MACOS
 #endif
 
+#include <string.h>
+#include <tskgfx/spirv.h>
+#include <tskgfx/tlsf.h>
+#include <tskgfx/tskgfx.h>
 #include <vma/vk_mem_alloc.h>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
+#include <vector>
+
 namespace tsk {
 
 constexpr int k_max_desciptors = 12;
 constexpr int k_max_program_ds_sets = 8;
 constexpr int k_max_program_set_bindings = 16;
 constexpr int k_max_pc_ranges = 1;
+constexpr int k_max_descriptor_sets = 256;  // Sets per pool of the chain.
+constexpr int k_min_descriptor_sets = 32;   // Sets of the first pool, each
+                                            // pool doubles up to the max.
+constexpr float k_descriptor_pool_headroom = 1.5f;  // Over the average
+                                                    // descriptors per set.
+constexpr uint32_t k_descriptor_type_count = 11;  // Up to input attachments.
+constexpr int k_max_cached_descriptor_sets = 1024;
+constexpr uint64_t k_descriptor_set_max_age = 240;  // Frames unused before a
+                                                    // cached set is evicted.
+
+// Bindless, see AppConfig::bindless.
+constexpr uint32_t k_bindless_set = 0;
+constexpr uint32_t k_bindless_program_set = 1;
+constexpr uint32_t k_bindless_texture_binding = 0;
+constexpr uint32_t k_bindless_sampler_binding = 1;
+constexpr uint32_t k_bindless_buffer_binding = 2;
+constexpr uint32_t k_max_bindless_textures = 512;
+constexpr uint32_t k_max_bindless_samplers = 64;
+constexpr uint32_t k_max_bindless_buffers = 512;
+
+// Descriptor buffer, initial bytes of descriptors written per frame context.
+// The buffer doubles when a frame writes more.
+constexpr VkDeviceSize k_descriptor_buffer_frame_size = 256 * 1024;
+
+// Programs with up to this many bindings push them per draw when
+// VK_KHR_push_descriptor is available.
+constexpr uint32_t k_max_push_descriptor_bindings = 8;
+
+// Mips of a texture, mip 0 up to 32768 texels wide.
+constexpr uint32_t k_max_texture_mips = 16;
+
+constexpr uint32_t k_stream_base_size = 64;  // Mips this size or smaller are
+                                             // always resident.
+constexpr int k_max_stream_uploads = 4;      // Textures streamed in per frame.
+
+constexpr VkDeviceSize k_mesh_vertex_arena_size = 64ull * 1024 * 1024;
+constexpr VkDeviceSize k_mesh_index_arena_size = 16ull * 1024 * 1024;
+constexpr VkDeviceSize k_mesh_vertex_alignment = 16;
+constexpr int k_max_mesh_arenas = 8;
 
 struct TextureVk {
   VkExtent3D extent;
@@ -37,19 +82,85 @@ struct TextureVk {
   VkImageView image_view;
   VmaAllocation allocation;
 
+  VkImageUsageFlags usage;
+  VkImageAspectFlags aspect;
+  VkImageViewType view_type;
+  MemoryCategory category;
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  uint32_t mip_levels = 1;
+  uint32_t array_layers = 1;
+
   /*@returns 'true' if the texture is valid and ready for usage.*/
   inline const bool valid() const {
     return image != VK_NULL_HANDLE && image_view != VK_NULL_HANDLE;
   }
 
+  /*@brief Creates the image and a view covering all of its subresources.*/
+  /**/
+  /*@note Extents with depth > 1 create 3D images, cube maps require a*/
+  /*multiple of 6 layers.*/
   void create(VkImageUsageFlags usage,
               VkExtent3D extent,
               VkFormat format,
-              VkImageAspectFlags aspect);
+              VkImageAspectFlags aspect,
+              uint32_t mip_levels = 1,
+              uint32_t array_layers = 1,
+              bool cube_map = false);
 
-  void update(VkCommandBuffer cmd, uint32_t offset, uint32_t size, void* data);
+  /*@brief Records an upload of mip 0 of the layers [first_layer,*/
+  /*first_layer + num_layers), tightly packed layer by layer.*/
+  void update(VkCommandBuffer cmd,
+              uint32_t first_layer,
+              uint32_t num_layers,
+              void* data);
+
+  /*@brief Records a transition of all subresources to the new layout.*/
+  void transition(VkCommandBuffer cmd, VkImageLayout new_layout);
+
+  /*@brief Labels the allocation for memory attribution.*/
+  void set_name(const char* name);
+
+  /*@returns The debug name of the allocation or null.*/
+  const char* name() const;
+
+  /*@brief Recreates the image in the memory of dst_allocation and records a*/
+  /*copy of its contents. Used by defragmentation.*/
+  /**/
+  /*@note The old image and view are returned and must be destroyed once the*/
+  /*copy has completed, the allocation is left untouched.*/
+  void move(VkCommandBuffer cmd,
+            VmaAllocation dst_allocation,
+            VkImage* old_image,
+            VkImageView* old_view);
 
   void destroy();
+
+  /*@returns Create info describing the image.*/
+  VkImageCreateInfo image_info() const;
+
+ private:
+  void create_view();
+};
+
+/*@brief Residency state of a texture whose mips are streamed on demand.*/
+/**/
+/*The gpu image only holds the mips [resident_mip, num_mips). Raising the*/
+/*resolution reallocates the image with more levels, so samplers never see*/
+/*missing mips. Clamping the view of a full chain image would keep the vram*/
+/*of evicted mips allocated, which the texture budget is meant to free.*/
+struct StreamingTextureVk {
+  VkExtent3D extent;  // Extent of mip 0.
+
+  const uint8_t* data = nullptr;  // Full mip chain, tightly packed from mip 0.
+
+  uint8_t num_mips = 0;
+  uint8_t min_resident_mip = 0;  // Mips at or above are never evicted.
+  uint8_t resident_mip = 0;
+  uint8_t requested_mip = UINT8_MAX;
+
+  uint64_t last_used_frame = 0;
+
+  inline const bool valid() const { return num_mips != 0; }
 };
 
 struct ShaderVk {
@@ -61,10 +172,24 @@ struct ShaderVk {
   VkPushConstantRange pc_ranges[k_max_pc_ranges];
   uint32_t n_pc_ranges = 0;
 
+  uint32_t constant_ids[k_max_specialization_constants];
+  uint32_t n_constants = 0;
+
+  // Handles of identical SPIR-V share the shader, keyed by its size and hash.
+  uint64_t content_key = 0;
+  uint32_t refs = 0;
+
+  // SPIR-V compared before sharing the shader, as hashes may collide. Points
+  // into the shader pack or at owned_spirv.
+  const void* spirv = nullptr;
+  std::vector<char> owned_spirv;
+
   // @returns 'true' if the shader is valid and ready for usage.
   inline const bool valid() const { return module != VK_NULL_HANDLE; }
 
-  void create(const char* path);
+  void create(const void* spirv,
+              size_t n_bytes,
+              const ReflectionRecord& reflection);
 
   void destroy();
 };
@@ -73,6 +198,8 @@ struct BufferVk {
  public:
   VkBuffer buffer = VK_NULL_HANDLE;
   VkDeviceAddress address = -1;
+  VkBufferUsageFlags usage = 0;
+  MemoryCategory category = MemoryCategory::k_buffer;
 
   /*@returns 'true' if the buffer is valid and ready for usage.*/
   inline const bool valid() const { return buffer != VK_NULL_HANDLE; }
@@ -91,6 +218,24 @@ struct BufferVk {
 
   void update(VkCommandBuffer cmd, uint32_t offset, uint32_t size, void* data);
 
+  /*@brief Labels the allocation for memory attribution.*/
+  void set_name(const char* name);
+
+  /*@returns The debug name of the allocation or null.*/
+  const char* name() const;
+
+  /*@returns Persistently mapped memory of mappable buffers.*/
+  void* mapped_data() const;
+
+  /*@returns The allocation backing the buffer.*/
+  inline const VmaAllocation vma_allocation() const { return allocation; }
+
+  /*@brief Recreates the buffer in the memory of dst_allocation and records a*/
+  /*copy of its contents. Used by defragmentation.*/
+  /**/
+  /*@returns The old buffer, to be destroyed once the copy has completed.*/
+  VkBuffer move(VkCommandBuffer cmd, VmaAllocation dst_allocation);
+
   void destroy();
 
  private:
@@ -98,6 +243,54 @@ struct BufferVk {
   VkDeviceSize device_size = 0;
 };
 
+/*@brief Identifies a pipeline permutation of a program, zeroed before*/
+/*filling as padding is compared.*/
+struct PipelineKeyVk {
+  VkPipelineLayout layout;
+  uint32_t state;  // Packed RenderState, 0 for compute, library part in the
+                  // high bits.
+  VkFormat color_format;
+  VkFormat depth_format;
+  uint32_t constants;  // Hash of the specialization constants, 0 for none.
+
+  bool operator==(const PipelineKeyVk& other) const {
+    return memcmp(this, &other, sizeof(PipelineKeyVk)) == 0;
+  }
+};
+
+/*@brief Inputs and result of a pipeline compiled on the pipeline workers.*/
+struct PipelineJobVk {
+  PipelineKeyVk key = {};
+  VkPipelineCreateFlags flags = 0;
+
+  // Part compiled as a pipeline library, 0 for complete pipelines.
+  VkGraphicsPipelineLibraryFlagsEXT library = 0;
+
+  // Libraries linked into the pipeline instead of compiling the stages.
+  VkPipeline libraries[4] = {};
+  uint32_t n_libraries = 0;
+
+  // Compute pipelines only have cs.
+  VkShaderModule vs = VK_NULL_HANDLE;
+  VkShaderModule fs = VK_NULL_HANDLE;
+  VkShaderModule cs = VK_NULL_HANDLE;
+
+  SpecializationConstant constants[k_max_specialization_constants];
+  uint32_t n_constants = 0;
+
+  // Written by the worker.
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  float create_ms = 0.0f;
+
+  bool cancelled = false;  // Program destroyed while compiling.
+};
+
+/*@brief Descriptor of a binding as read by a descriptor update template.*/
+union DescriptorUpdateDataVk {
+  VkDescriptorBufferInfo buffer;
+  VkDescriptorImageInfo image;
+};
+
 /*@brief Defines the state and required to create and identify a pipeline.*/
 struct ProgramVk {
   VkDescriptorSetLayout descriptor_set_layout;
@@ -105,6 +298,45 @@ struct ProgramVk {
 
   uint8_t n_bindings = 0;
   uint8_t n_pc_ranges = 0;
+  VkShaderStageFlags pc_stages = VK_SHADER_STAGE_VERTEX_BIT;
+
+  // Bindings of the set, compared before drawing with the fallback program.
+  VkDescriptorSetLayoutBinding set_bindings[k_max_program_set_bindings] = {};
+
+  // Size and binding offsets of the set in a descriptor buffer.
+  VkDeviceSize descriptor_buffer_size = 0;
+  VkDeviceSize binding_offsets[k_max_program_set_bindings] = {};
+
+  // Pipelines are compiled per RenderState from these on first use.
+  VkShaderModule vs_module = VK_NULL_HANDLE;
+  VkShaderModule fs_module = VK_NULL_HANDLE;
+  VkShaderModule cs_module = VK_NULL_HANDLE;
+  VkPipelineCreateFlags pipeline_flags = 0;
+
+  // ShaderVk::content_key of vs and fs, or of cs, recorded with the pipelines
+  // drawn, see AppConfig::pso_usage_path.
+  uint64_t shader_keys[2] = {};
+
+  // Specialization constants declared by the shaders.
+  uint32_t constant_ids[k_max_specialization_constants] = {};
+  uint8_t n_constant_ids = 0;
+
+  // Variants override constants of their base program, whose layouts,
+  // template and pool descriptors they share. The hash keys their pipelines,
+  // it is unique among the variants of the base.
+  ProgramHandle base;
+  uint32_t constants_hash = 0;
+  SpecializationConstant constants[k_max_specialization_constants] = {};
+  uint8_t n_constants = 0;
+
+  // Descriptors per VkDescriptorType of the set, when allocated from pools.
+  bool pooled = false;
+  uint8_t pool_descriptors[k_descriptor_type_count] = {};
+
+  // Set pushed per draw with update_template, reading one
+  // DescriptorUpdateDataVk per binding.
+  bool push_descriptors = false;
+  VkDescriptorUpdateTemplate update_template = VK_NULL_HANDLE;
 
   /*@returns 'true' of the texture is valid and ready for usage.*/
   inline const bool valid() const {
@@ -118,6 +350,109 @@ struct ProgramVk {
   void destroy();
 };
 
+/*@brief A large vertex and index buffer pair meshes are sub-allocated from.*/
+struct MeshArenaVk {
+  BufferVk vertices;
+  BufferVk indices;
+
+  TlsfAllocator vertex_allocator;
+  TlsfAllocator index_allocator;
+
+  /*@returns 'true' if the arena is valid and ready for usage.*/
+  inline const bool valid() const { return vertices.valid(); }
+};
+
+/*@brief Vertex and index ranges of a mesh in its arena.*/
+struct MeshVk {
+  uint32_t arena = 0;
+  uint32_t index_count = 0;
+
+  TlsfAllocator::Allocation vertices;
+  TlsfAllocator::Allocation indices;
+
+  /*@returns 'true' if the mesh is valid and ready for usage.*/
+  inline const bool valid() const { return vertices.valid(); }
+
+  /*@returns Index of the first index of the mesh in the arena.*/
+  inline const uint32_t first_index() const {
+    return static_cast<uint32_t>(indices.offset / sizeof(uint32_t));
+  }
+
+  /*@brief Returns the ranges to the arena.*/
+  void destroy();
+};
+
+constexpr uint32_t k_pipeline_cache_magic = 0x4f535054;  // "TPSO"
+constexpr uint32_t k_pipeline_cache_version = 1;
+
+/*@brief Header of the pipeline cache file, the cache data follows and is*/
+/*only used if the header matches the device and driver.*/
+struct PipelineCacheHeaderVk {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t data_size;
+  uint32_t data_hash;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint32_t driver_version;
+  uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+  uint8_t driver_uuid[VK_UUID_SIZE];
+};
+
+static_assert(sizeof(PipelineCacheHeaderVk) == 64,
+              "Pipeline cache header must not have padding!");
+
+constexpr uint32_t k_pso_usage_magic = 0x55535054;  // "TPSU"
+constexpr uint32_t k_pso_usage_version = 1;
+
+/*@brief Header of the pso usage file, n_records PsoUsageVk follow.*/
+struct PsoUsageHeaderVk {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t n_records;
+  uint32_t padding;
+};
+
+/*@brief A pipeline drawn in a session, identified by what is stable across*/
+/*runs instead of handles, zeroed before filling as padding is compared.*/
+struct PsoUsageVk {
+  uint64_t shader_keys[2];  // See ProgramVk::shader_keys.
+  uint32_t constants;       // Hash of the specialization constants.
+  uint32_t state;           // Packed RenderState, dynamic bits included.
+  VkFormat color_format;
+  VkFormat depth_format;
+
+  bool operator==(const PsoUsageVk& other) const {
+    return memcmp(this, &other, sizeof(PsoUsageVk)) == 0;
+  }
+};
+
+static_assert(sizeof(PsoUsageVk) == 32, "Pso usage must not have padding!");
+
+/*@brief A descriptor set and the pool it was allocated from.*/
+struct DescriptorSetAllocationVk {
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  VkDescriptorSet set = VK_NULL_HANDLE;
+};
+
+/*@brief Objects released while they may still be in use by a frame in*/
+/*flight, destroyed once the fence of that frame context has signaled.*/
+struct DeletionQueueVk {
+  std::vector<BufferVk> buffers;
+  std::vector<TextureVk> textures;
+  std::vector<VkPipeline> pipelines;
+  std::vector<VkPipelineLayout> pipeline_layouts;
+  std::vector<VkDescriptorSetLayout> descriptor_set_layouts;
+  std::vector<VkDescriptorUpdateTemplate> update_templates;
+  std::vector<DescriptorSetAllocationVk> descriptor_sets;
+  std::vector<MeshVk> meshes;
+
+  /*@brief Destroys all queued objects.*/
+  /**/
+  /*@attention The frame context owning the queue must have retired.*/
+  void flush();
+};
+
 // Vulkan core.
 extern VkInstance instance;
 extern VkPhysicalDevice physical_device;
@@ -0,0 +1,101 @@
+/**
+ * @file shader_pack.h
+ * @brief This file contains the shader pack, an archive of SPIR-V blobs.
+ *
+ * A pack is a header, entries sorted by name hash and the 4 byte aligned
+ * SPIR-V of each entry. Packs are memory mapped and shader modules are
+ * created from the mapping, with the reflection stored in the entries.
+ *
+ * @author Moka
+ * @date 2024-11-03
+ */
+
+#ifndef SHADER_PACK_H_
+#define SHADER_PACK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <tskgfx/spirv.h>
+
+namespace tsk {
+
+constexpr uint32_t k_shader_pack_magic = 0x4b505354;  // "TSPK"
+constexpr uint32_t k_shader_pack_version = 1;
+constexpr uint32_t k_max_shader_pack_name = 128;
+
+/* @brief Header at the start of a pack.*/
+struct ShaderPackHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t n_entries;
+  uint32_t padding;
+};
+
+/* @brief Index entry of a packed shader.*/
+struct ShaderPackEntry {
+  uint32_t name_hash;  // tsk::murmur_hash3_x86_32 of the name, seed 0.
+  uint32_t padding;
+  uint64_t offset;  // Of the SPIR-V from the start of the pack.
+  char name[k_max_shader_pack_name];
+
+  // Size and hash of the SPIR-V are those of the record.
+  ReflectionRecord reflection;
+};
+
+/// @brief Read only view of a memory mapped shader pack.
+struct ShaderPack {
+ public:
+  /// @returns 'false' if the file is missing or not a valid pack.
+  bool open(const char* path);
+
+  void close();
+
+  /// @returns Entry of a shader by the name it was packed with, nullptr if
+  /// not packed.
+  const ShaderPackEntry* find(const char* name) const;
+
+  /// @returns Entry of a shader by the hash of its SPIR-V, nullptr if not
+  /// packed.
+  const ShaderPackEntry* find(uint32_t spirv_hash) const;
+
+  /// @returns SPIR-V of an entry, valid while the pack is open.
+  inline const void* spirv(const ShaderPackEntry& entry) const {
+    return data + entry.offset;
+  }
+
+  inline const uint32_t count() const {
+    return data != nullptr
+               ? reinterpret_cast<const ShaderPackHeader*>(data)->n_entries
+               : 0;
+  }
+
+  /*@returns 'true' if the pack is open.*/
+  inline const bool valid() const { return data != nullptr; }
+
+ private:
+  inline const ShaderPackEntry* entries() const {
+    return reinterpret_cast<const ShaderPackEntry*>(data +
+                                                    sizeof(ShaderPackHeader));
+  }
+
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+#ifdef TUSK_WIN32
+  void* file = nullptr;
+  void* mapping = nullptr;
+#endif
+};
+
+/// @brief Packs SPIR-V files, e.g. offline. Shaders are named by their path
+/// as passed to create_shader.
+///
+/// @param[in] set Set reflected, see parse_spirv.
+bool write_shader_pack(const char* path,
+                       const char* const* spirv_paths,
+                       uint32_t count,
+                       uint32_t set);
+
+}  // namespace tsk
+
+#endif
@@ -0,0 +1,33 @@
+// @file bindless.glsl
+// @brief Declares the bindless set, see tsk::AppConfig::bindless.
+//
+// 2D textures and buffers are indexed by their handle, sampler 0 is the
+// default sampler. Other texture types and program descriptors are declared
+// in set 1:
+//
+//   #include "tskgfx/shaders/bindless.glsl"
+//   vec4 color = bindless_sample(material.albedo_th, 0, uv);
+
+#ifndef TSKGFX_BINDLESS_GLSL_
+#define TSKGFX_BINDLESS_GLSL_
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+// tsk::k_bindless_set and bindings.
+layout(set = 0, binding = 0) uniform texture2D bindless_textures[];
+layout(set = 0, binding = 1) uniform sampler bindless_samplers[];
+
+// Raw words of buffers, alias with a typed declaration of binding 2 to read
+// structured data.
+layout(set = 0, binding = 2) readonly buffer BindlessBuffers {
+  uint data[];
+} bindless_buffers[];
+
+// Indices may diverge within a draw, e.g. when sourced from per instance data.
+vec4 bindless_sample(uint th, uint sampler_index, vec2 uv) {
+  return texture(sampler2D(bindless_textures[nonuniformEXT(th)],
+                           bindless_samplers[nonuniformEXT(sampler_index)]),
+                 uv);
+}
+
+#endif
@@ -0,0 +1,78 @@
+// @file vertex_decode.glsl
+// @brief Decodes vertices pulled through the vertex address, see
+// tsk::VertexEncoding.
+//
+// Requires GL_EXT_buffer_reference, include once per shader:
+//
+//   #include "tskgfx/shaders/vertex_decode.glsl"
+//   DecodedVertex v = decode_vertex_compressed(pc.vbo, gl_VertexIndex);
+
+#ifndef TSKGFX_VERTEX_DECODE_GLSL_
+#define TSKGFX_VERTEX_DECODE_GLSL_
+
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+struct DecodedVertex {
+  vec3 position;
+  vec3 normal;
+  vec2 uv;
+};
+
+// VertexEncoding::k_float32, tsk::Vertex.
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer
+    VerticesF32 {
+  float data[];
+};
+
+// VertexEncoding::k_compressed, tsk::VertexEncodingHeader followed by
+// tsk::CompressedVertex.
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer
+    VertexEncodingHeader {
+  vec4 offset;
+  vec4 scale;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer
+    VerticesCompressed {
+  uvec4 data[];
+};
+
+DecodedVertex decode_vertex_f32(uint64_t address, uint index) {
+  VerticesF32 vertices = VerticesF32(address);
+  uint base = index * 8;
+
+  DecodedVertex v;
+  v.position = vec3(vertices.data[base + 0],
+                    vertices.data[base + 1],
+                    vertices.data[base + 2]);
+  v.normal = vec3(vertices.data[base + 3],
+                  vertices.data[base + 4],
+                  vertices.data[base + 5]);
+  v.uv = vec2(vertices.data[base + 6], vertices.data[base + 7]);
+  return v;
+}
+
+// Octahedral snorm to unit vector.
+vec3 decode_octahedral(vec2 oct) {
+  vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+  float t = max(-n.z, 0.0);
+  n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+  return normalize(n);
+}
+
+DecodedVertex decode_vertex_compressed(uint64_t address, uint index) {
+  VertexEncodingHeader header = VertexEncodingHeader(address);
+  VerticesCompressed vertices = VerticesCompressed(address + 32);
+  uvec4 packed = vertices.data[index];
+
+  vec3 unorm = vec3(unpackUnorm2x16(packed.x), unpackUnorm2x16(packed.y).x);
+
+  DecodedVertex v;
+  v.position = header.offset.xyz + unorm * header.scale.xyz;
+  v.normal = decode_octahedral(unpackSnorm2x16(packed.z));
+  v.uv = unpackHalf2x16(packed.w);
+  return v;
+}
+
+#endif
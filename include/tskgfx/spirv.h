@@ -13,12 +13,94 @@
 
 namespace tsk {
 
+constexpr uint32_t k_spirv_any_set = UINT32_MAX;
+
+constexpr uint32_t k_reflection_magic = 0x4c465254;  // "TRFL"
+constexpr uint32_t k_reflection_version = 1;
+constexpr uint32_t k_max_reflected_bindings = 16;
+constexpr uint32_t k_max_reflected_pc_ranges = 1;
+constexpr uint32_t k_max_reflected_variables = 16;
+constexpr uint32_t k_max_reflected_constants = 16;
+
+/* @brief Descriptor binding of a reflected set.*/
+struct ReflectedBinding {
+  uint32_t binding;
+  uint32_t type;  // VkDescriptorType.
+  uint32_t count;
+  uint32_t padding;
+};
+
+/* @brief Input or output variable of a shader interface.*/
+struct ReflectedVariable {
+  uint32_t location;
+  uint32_t format;  // VkFormat.
+  uint32_t output;  // 1 for outputs, 0 for inputs.
+  uint32_t padding;
+};
+
+/* @brief Reflection of a shader, stored next to its SPIR-V as <path>.refl*/
+/* and read back as is. Records of other SPIR-V or sets are ignored.*/
+struct ReflectionRecord {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t spirv_size;
+  uint32_t spirv_hash;  // tsk::murmur_hash3_x86_32 of the SPIR-V, seed 0.
+  uint32_t set;
+
+  uint32_t n_bindings;
+  uint32_t n_pc_ranges;
+  uint32_t n_variables;
+  uint32_t n_constants;
+
+  ReflectedBinding bindings[k_max_reflected_bindings];
+  VkPushConstantRange pc_ranges[k_max_reflected_pc_ranges];
+  ReflectedVariable variables[k_max_reflected_variables];
+  uint32_t constant_ids[k_max_reflected_constants];
+};
+
+/// @brief Reflects the descriptor bindings and push constant ranges of a
+/// shader.
+///
+/// @param[in] set Only bindings of this descriptor set are returned.
 bool parse_spirv(const void* spirv_code,
                  size_t spirv_nbytes,
                  VkDescriptorSetLayoutBinding* bindings,
                  uint32_t* n_bindings,
                  VkPushConstantRange* push_constant_ranges,
-                 uint32_t* n_push_constant_ranges);
+                 uint32_t* n_push_constant_ranges,
+                 uint32_t set = k_spirv_any_set);
+
+/// @brief Reflects a shader into a record, e.g. to write it offline.
+///
+/// @param[in] spirv_hash See ReflectionRecord::spirv_hash.
+bool reflect_spirv(const void* spirv_code,
+                   size_t spirv_nbytes,
+                   uint32_t spirv_hash,
+                   uint32_t set,
+                   ReflectionRecord* record);
+
+/// @returns 'true' if a record is of this format, of non empty SPIR-V words
+/// and within the record capacities.
+bool valid_reflection(const ReflectionRecord& record);
+
+/// @brief Reads the record of a shader written by write_reflection.
+///
+/// @returns 'false' if missing or not of this SPIR-V and set.
+bool read_reflection(const char* path,
+                     size_t spirv_nbytes,
+                     uint32_t spirv_hash,
+                     uint32_t set,
+                     ReflectionRecord* record);
+
+bool write_reflection(const char* path, const ReflectionRecord& record);
+
+/// @brief Reflects the specialization constants of a shader.
+///
+/// @param[out] constant_ids May be null to query n_constants.
+bool parse_spirv_constants(const void* spirv_code,
+                           size_t spirv_nbytes,
+                           uint32_t* constant_ids,
+                           uint32_t* n_constants);
 
 }  // namespace tsk
 
@@ -0,0 +1,58 @@
+/**
+ * @file thread_pool.h
+ * @brief This file contains a fixed size pool of worker threads.
+ *
+ * Jobs run in submission order on the first idle worker, they must not touch
+ * state owned by the submitting thread without synchronization.
+ *
+ * @author Moka
+ * @date 2024-11-03
+ */
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tsk {
+
+/// @brief Runs jobs on a fixed number of worker threads.
+struct ThreadPool {
+ public:
+  /// @brief Starts thread_count workers, 0 for all cores but the calling one.
+  void start(uint32_t thread_count = 0);
+
+  /// @brief Runs the queued jobs to completion and joins the workers.
+  void stop();
+
+  void submit(std::function<void()> job);
+
+  /// @returns Number of jobs queued or running.
+  uint32_t pending();
+
+  inline const uint32_t thread_count() const {
+    return static_cast<uint32_t>(threads.size());
+  }
+
+ private:
+  void run();
+
+  std::vector<std::thread> threads;
+  std::deque<std::function<void()>> jobs;
+
+  std::mutex mutex;
+  std::condition_variable job_available;
+  uint32_t running = 0;
+  bool stopping = false;
+};
+
+}  // namespace tsk
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * @file tlsf.h
+ * @brief This file contains a two-level segregated fit range allocator.
+ *
+ * The allocator only hands out offsets into a range of a given size, it owns
+ * no memory and is used to sub-allocate gpu buffers.
+ *
+ * @author Moka
+ * @date 2024-11-03
+ */
+
+#ifndef TLSF_H_
+#define TLSF_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace tsk {
+
+/// @brief O(1) allocator of ranges in [0, size).
+///
+/// Free ranges are binned by a first level power of two and 16 linear second
+/// level subdivisions, a bitmap per level finds a fitting bin in constant
+/// time. Freed ranges are merged with free neighbours immediately.
+struct TlsfAllocator {
+ public:
+  static constexpr uint32_t k_invalid_node = UINT32_MAX;
+
+  struct Allocation {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t node = k_invalid_node;
+
+    inline const bool valid() const { return node != k_invalid_node; }
+  };
+
+  /// @brief Resets the allocator to a single free range of size bytes.
+  void init(uint64_t size);
+
+  /// @returns A range of at least size bytes, invalid if none fits.
+  Allocation allocate(uint64_t size);
+
+  void free(const Allocation& allocation);
+
+  /// @returns Total size of the managed range.
+  inline const uint64_t size() const { return total_size; }
+
+  /// @returns Bytes not allocated, possibly fragmented.
+  inline const uint64_t free_size() const { return total_free; }
+
+ private:
+  static constexpr uint32_t k_sl_log = 4;
+  static constexpr uint32_t k_sl_count = 1 << k_sl_log;
+  static constexpr uint32_t k_fl_count = 64 - k_sl_log + 1;
+
+  struct Node {
+    uint64_t offset;
+    uint64_t size;
+
+    // Neighbouring ranges in address order.
+    uint32_t prev_phys;
+    uint32_t next_phys;
+
+    // Links in the free list of the bin, only for free ranges.
+    uint32_t prev_free;
+    uint32_t next_free;
+
+    bool used;
+  };
+
+  uint32_t new_node();
+  void insert_free(uint32_t node);
+  void remove_free(uint32_t node);
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> unused_nodes;
+
+  uint64_t fl_bitmap = 0;
+  uint32_t sl_bitmaps[k_fl_count] = {};
+  uint32_t free_heads[k_fl_count][k_sl_count] = {};
+
+  uint64_t total_size = 0;
+  uint64_t total_free = 0;
+};
+
+}  // namespace tsk
+
+#endif
@@ -17,6 +17,11 @@ namespace tsk {
 
 constexpr uint8_t k_frame_overlap = 2;
 constexpr uint32_t k_max_draws = 256;
+constexpr uint32_t k_max_specialization_constants = 16;  // Per program.
+
+constexpr uint32_t k_max_uniform_size = 16 * 1024;  // Per set_uniform call.
+constexpr uint32_t k_uniform_alignment = 256;
+constexpr uint32_t k_max_frame_uniform_bytes = 1024 * 1024;
 
 /* @enum Format*/
 /* @brief Represents texture and pixel formats used in the renderer.*/
@@ -324,6 +329,220 @@ struct TUSK_API TextureInfo {
   uint8_t num_mips;     //!< number of MIP maps.
   /*uint8_t bits_per_pixel;		//!< format bits per pixel.*/
   bool cube_map;  //!< texture is cubemap.
+  bool streaming;  //!< mips are streamed in on demand (see request_texture_lod).
+};
+
+/* @note Filter, MipmapMode, AddressMode and CompareOp map one-to-one to the*/
+/* Vulkan enums.*/
+enum class Filter : uint8_t {
+  k_nearest = 0,
+  k_linear = 1,
+};
+
+enum class MipmapMode : uint8_t {
+  k_nearest = 0,
+  k_linear = 1,
+};
+
+enum class AddressMode : uint8_t {
+  k_repeat = 0,
+  k_mirrored_repeat = 1,
+  k_clamp_to_edge = 2,
+  k_clamp_to_border = 3,
+};
+
+enum class CompareOp : uint8_t {
+  k_never = 0,
+  k_less = 1,
+  k_equal = 2,
+  k_less_or_equal = 3,
+  k_greater = 4,
+  k_not_equal = 5,
+  k_greater_or_equal = 6,
+  k_always = 7,
+};
+
+constexpr float k_lod_clamp_none = 1000.0f;
+
+/* @note CullMode and Topology map one-to-one to the Vulkan enums.*/
+enum class CullMode : uint8_t {
+  k_none = 0,
+  k_front = 1,
+  k_back = 2,
+};
+
+enum class Topology : uint8_t {
+  k_point_list = 0,
+  k_line_list = 1,
+  k_line_strip = 2,
+  k_triangle_list = 3,
+  k_triangle_strip = 4,
+};
+
+enum class BlendMode : uint8_t {
+  k_opaque = 0,         //!< blending off.
+  k_alpha = 1,          //!< src * a + dst * (1 - a).
+  k_additive = 2,       //!< src * a + dst.
+  k_premultiplied = 3,  //!< src + dst * (1 - a).
+};
+
+/* @brief Fixed function state of a draw, see set_state.*/
+/**/
+/* Each state a program is drawn with compiles its own pipeline on first use,*/
+/* draws are skipped or use the fallback program until it is ready. States*/
+/* set dynamically share pipelines, see AppConfig::dynamic_state.*/
+struct TUSK_API RenderState {
+  Topology topology = Topology::k_triangle_list;
+  CullMode cull_mode = CullMode::k_none;
+  bool depth_test = true;
+  bool depth_write = true;
+  CompareOp depth_op = CompareOp::k_greater_or_equal;  //!< inverted depth.
+  BlendMode blend = BlendMode::k_alpha;
+};
+
+/* @brief Value of a shader specialization constant, see*/
+/* create_program_variant.*/
+struct TUSK_API SpecializationConstant {
+  uint32_t id;     //!< constant_id declared in the shader.
+  uint32_t value;  //!< bits of the bool, int, uint or float value.
+};
+
+/* @brief Describes how textures are sampled.*/
+/**/
+/* Samplers are cached by description, identical descriptions share one*/
+/* sampler.*/
+struct TUSK_API SamplerInfo {
+  Filter min_filter = Filter::k_nearest;
+  Filter mag_filter = Filter::k_nearest;
+  MipmapMode mip_mode = MipmapMode::k_nearest;
+  AddressMode address_u = AddressMode::k_repeat;
+  AddressMode address_v = AddressMode::k_repeat;
+  AddressMode address_w = AddressMode::k_repeat;
+  bool compare = false;  //!< compares against compare_op, e.g. shadow maps.
+  CompareOp compare_op = CompareOp::k_never;
+  float max_anisotropy = 0.0f;  //!< 0 or 1 disables anisotropic filtering.
+  float mip_lod_bias = 0.0f;
+  float min_lod = 0.0f;
+  float max_lod = k_lod_clamp_none;
+};
+
+/* @enum VertexEncoding*/
+/* @brief Encodings of vertices pulled through the vertex address.*/
+/**/
+/* Encoded vertex buffers are created from Vertex data. Compressed vertices*/
+/* are prefixed by a VertexEncodingHeader holding the quantization bounds,*/
+/* shaders decode them with 'tskgfx/shaders/vertex_decode.glsl'.*/
+enum class VertexEncoding : uint8_t {
+  k_raw = 0,         //!< data is uploaded as is.
+  k_float32 = 1,     //!< Vertex, 32 bytes.
+  k_compressed = 2,  //!< unorm16x3 position in mesh bounds, octahedral
+                     //!< snorm16x2 normal, half2 uv, 16 bytes.
+};
+
+/* @brief Source vertex of encoded vertex buffers.*/
+struct TUSK_API Vertex {
+  float position[3];
+  float normal[3];  //!< unit length.
+  float uv[2];
+};
+
+/* @brief Quantization bounds of compressed vertices, position = offset +*/
+/* scale * unorm.*/
+struct TUSK_API VertexEncodingHeader {
+  float offset[4];
+  float scale[4];
+};
+
+/* @enum MemoryCategory*/
+/* @brief Categories gpu memory is attributed to.*/
+enum class MemoryCategory : uint32_t {
+  k_buffer = 0,         //!< vertex, index, uniform and storage buffers.
+  k_texture = 1,        //!< sampled textures.
+  k_staging = 2,        //!< transient upload buffers.
+  k_render_target = 3,  //!< color and depth attachments.
+
+  k_count
+};
+
+constexpr uint32_t k_max_memory_heaps = 16;
+
+/* @brief Budget and usage of a gpu memory heap.*/
+struct TUSK_API MemoryHeapStats {
+  uint64_t budget;    //!< bytes the process can use before the driver pages.
+  uint64_t usage;     //!< bytes currently used by the process.
+  bool device_local;  //!< heap lives in vram.
+};
+
+/* @brief Snapshot of gpu memory budgets and usage.*/
+struct TUSK_API MemoryStats {
+  uint32_t heap_count;
+  MemoryHeapStats heaps[k_max_memory_heaps];
+  uint64_t category_bytes[static_cast<uint32_t>(MemoryCategory::k_count)];
+};
+
+/* @brief Memory used by a single resource.*/
+struct TUSK_API ResourceMemoryInfo {
+  const char* name;  //!< debug name, empty if the resource was never named.
+  MemoryCategory category;
+  uint64_t size;  //!< allocated bytes.
+};
+
+/* @brief Called once when a heap's usage crosses the warning threshold.*/
+typedef void (*MemoryWarningFn)(const MemoryStats& stats, uint32_t heap);
+
+/* @brief Progress and results of gpu memory defragmentation.*/
+struct TUSK_API DefragmentationStats {
+  float fragmentation_before;  //!< % of unused bytes in memory blocks at start.
+  float fragmentation_after;   //!< % of unused bytes once finished.
+  uint64_t bytes_moved;
+  uint32_t allocations_moved;
+  uint32_t passes;
+  bool running;
+};
+
+/* @brief Counters of the descriptor set cache since initialization.*/
+struct TUSK_API DescriptorCacheStats {
+  uint64_t hits;
+  uint64_t misses;     //!< sets allocated and written.
+  uint64_t evictions;  //!< sets evicted by age or the cache bound.
+  uint32_t cached_sets;
+  uint32_t pools;  //!< descriptor pools in the chain.
+  bool descriptor_buffer;  //!< descriptors are written per draw to a
+                           //!< descriptor buffer instead of cached sets.
+  uint32_t push_descriptor_programs;  //!< programs pushing their bindings
+                                      //!< per draw instead of cached sets.
+};
+
+/* @brief Persistent pipeline cache, see AppConfig::pipeline_cache_path.*/
+struct TUSK_API PipelineCacheStats {
+  bool warm;              //!< a valid cache file was loaded at init.
+  uint64_t loaded_bytes;  //!< cache data loaded at init.
+  uint64_t saved_bytes;   //!< cache data of the last save.
+  uint32_t pipelines_created;
+  float create_ms;  //!< cpu time spent creating pipelines, compare warm and
+                    //!< cold starts.
+  float init_ms;    //!< cpu time of init.
+  bool dynamic_state;  //!< see AppConfig::dynamic_state.
+  bool dynamic_blend;  //!< blending is set per draw too.
+  bool pipeline_library;  //!< pipelines are fast linked from libraries
+                          //!< compiled per shader and state part.
+  uint32_t pipelines_linked;  //!< fast linked on the render thread, an
+                              //!< optimized link replaces them.
+  float link_ms;              //!< cpu time spent fast linking.
+  uint32_t warmup_recorded;   //!< pipelines of the last run's usage file.
+  uint32_t warmup_requested;  //!< of them, of the programs created so far.
+  uint32_t warmup_compiled;   //!< requested pipelines ready to draw.
+  float warmup_ms;  //!< time from init until the last requested pipeline
+                    //!< was ready.
+};
+
+/* @brief Per frame statistics of the texture streamer.*/
+struct TUSK_API TextureStreamingStats {
+  uint64_t resident_bytes;    //!< bytes of streamed textures resident in vram.
+  uint64_t budget_bytes;      //!< vram budget of streamed textures.
+  uint32_t pending_requests;  //!< textures still waiting for higher mips.
+  uint32_t uploads;           //!< mips streamed in this frame.
+  uint32_t evictions;         //!< mips evicted this frame.
 };
 
 /// @brief Structure to hold application configuration settings.
@@ -347,12 +566,44 @@ struct TUSK_API TextureInfo {
 ///
 /// @var AppConfig::height
 /// Height of the application window in pixels.
+///
+/// @var AppConfig::bindless
+/// Binds 2D textures, samplers and buffers once per frame in set 0, indexed
+/// by handle, see tskgfx/shaders/bindless.glsl. Every buffer is bound as a
+/// storage buffer, other texture types through program descriptors. Program
+/// descriptors move to set 1. Requires descriptor indexing.
+///
+/// @var AppConfig::pipeline_cache_path
+/// File the pipeline cache is loaded from at init and saved to at shutdown,
+/// nullptr to not persist pipelines. Files of another device or driver are
+/// ignored.
+///
+/// @var AppConfig::shader_pack_path
+/// Shader pack mapped at init, see tskgfx/shader_pack.h. create_shader finds
+/// packed shaders by path and creates them from the mapping, others are read
+/// from files. nullptr to read every shader from its file.
+///
+/// @var AppConfig::dynamic_state
+/// Sets the topology, cull mode and depth state of RenderState per draw
+/// instead of compiling a pipeline per state, and blending with
+/// VK_EXT_extended_dynamic_state3. Programs then compile few pipelines. Off
+/// by default, requires Vulkan 1.3 extended dynamic state.
+///
+/// @var AppConfig::pso_usage_path
+/// File the pipelines drawn in a run are recorded to at shutdown, nullptr to
+/// not record. Pipelines recorded by the last run are compiled on the pipeline
+/// workers as soon as their program is created, before its first draw.
 struct TUSK_API AppConfig {
   char app_name[256];
   void* nwh;
   void* ndt;
   int width;
   int height;
+  bool bindless = false;
+  const char* pipeline_cache_path = nullptr;
+  const char* shader_pack_path = nullptr;
+  bool dynamic_state = false;
+  const char* pso_usage_path = nullptr;
 };
 
 /// @brief Initializes the tgfx library.
@@ -396,13 +647,18 @@ TUSK_HANDLE(BufferHandle);
 TUSK_HANDLE(TextureHandle);
 TUSK_HANDLE(VertexLayoutHandle);
 TUSK_HANDLE(FrameBufferHandle);
+TUSK_HANDLE(MeshHandle);
 
 /// @brief Creates and caches a shader program.
 ///
 /// @param[in] path Shader spriv.
 /// @returns program Reference to shader that was created.
+///
+/// @note Shaders are cached by content, identical SPIR-V returns the handle
+/// of the loaded shader and must be destroyed as often as created.
 TUSK_API ShaderHandle create_shader(const char* path);
 
+/// @brief Releases a shader, it is destroyed with its last reference.
 TUSK_API void destroy(ShaderHandle sh);
 
 /// @brief Creates a compute shader.
@@ -419,10 +675,49 @@ TUSK_API ProgramHandle create_program(ShaderHandle csh);
 ///
 /// @note This function will create a program if at least one vsh/fsh path is
 /// passed.
+/// @note Pipelines compile on worker threads, see is_ready.
 TUSK_API ProgramHandle create_program(ShaderHandle vsh, ShaderHandle fsh);
 
+/// @brief Destroys a program and its pipeline once no frame in flight uses
+/// them.
 TUSK_API void destroy(ProgramHandle ph);
 
+/// @returns `true` once the pipeline of a program has compiled. Draws of
+/// programs that are not ready are skipped or use the fallback program.
+TUSK_API bool is_ready(ProgramHandle ph);
+
+/// @brief Sets the program drawn in place of programs still compiling.
+///
+/// @note The fallback is drawn with the descriptors of the replaced draw, it
+/// must declare the same bindings or none. Draws whose bindings differ from
+/// those of the fallback are skipped.
+TUSK_API void set_fallback_program(ProgramHandle ph);
+
+/// @brief Creates a variant of a program with specialization constants, the
+/// driver compiles out the branches they disable.
+///
+/// Variants share the layouts and shader modules of their program and are
+/// cached by constants, identical constants return the same variant.
+///
+/// @param[in] constants Constants overriding the shader defaults, ids not
+/// declared by the program are ignored.
+/// @returns Variant, or ph if no constant is overridden.
+///
+/// @note Variants are destroyed with their program.
+TUSK_API ProgramHandle create_program_variant(
+    ProgramHandle ph,
+    const SpecializationConstant* constants,
+    uint32_t count);
+
+/// @brief Reflects the specialization constants declared by a program's
+/// shaders.
+///
+/// @param[out] ids constant_ids, up to k_max_specialization_constants, may be
+/// null.
+/// @returns Number of constants.
+TUSK_API uint32_t get_specialization_constants(ProgramHandle ph,
+                                               uint32_t* ids);
+
 /// @brief Creates descriptor.
 ///
 /// @param[in] path Unique name of descriptor.
@@ -433,6 +728,20 @@ TUSK_API DescriptorHandle create_descriptor(const char* name,
                                             DescriptorType type,
                                             uint16_t rh);
 
+/// @brief Creates a combined image sampler descriptor.
+///
+/// @param[in] sampler Description of the sampler, see SamplerInfo.
+TUSK_API DescriptorHandle create_descriptor(const char* name,
+                                            TextureHandle th,
+                                            const SamplerInfo& sampler);
+
+/// @returns Index of the sampler in the bindless sampler array, see
+/// AppConfig::bindless. Index 0 is the default SamplerInfo.
+TUSK_API uint32_t get_bindless_sampler(const SamplerInfo& sampler);
+
+/// @brief Destroys a descriptor and the cached sets referencing it.
+///
+/// @note Released objects are destroyed once no frame in flight uses them.
 TUSK_API void destroy(DescriptorHandle sh);
 
 // TODO: Make buffer *data const if not owning.
@@ -446,6 +755,23 @@ TUSK_API void destroy(DescriptorHandle sh);
 /// (call to tgfx::frame).
 TUSK_API BufferHandle create_uniform_buffer(uint32_t size, void* data);
 
+/// @brief Creates a vertex layout encoding vertex data on creation.
+///
+/// @param[in] encoding Encoding of the vertices in gpu memory.
+/// @returns layout Reference to the layout created.
+///
+/// @note Buffers and meshes created without a layout upload data as is.
+TUSK_API VertexLayoutHandle create_vertex_layout(VertexEncoding encoding);
+
+/// @brief Creates a vertex buffer.
+///
+/// @param[in] vlh Layout to encode data with, data must be an array of
+/// Vertex unless the encoding is raw.
+/// @param[in] size in bytes of the data.
+/// @param[in] data that will be encoded and copied to the buffer.
+/// @returns buffer Reference to the buffer created.
+///
+/// @note Updates of encoded buffers must pass encoded data.
 TUSK_API BufferHandle create_vertex_buffer(VertexLayoutHandle vlh,
                                            uint32_t size,
                                            void* data);
@@ -473,24 +799,167 @@ TUSK_API void update(BufferHandle bh,
 /// @brief Destroys a buffer.
 ///
 /// @param[in] buffer_handle Buffer handle.
+///
+/// @note The gpu buffer is destroyed once no frame in flight uses it.
 TUSK_API void destroy(BufferHandle bh);
 
+/// @brief Creates a mesh sub-allocated from the shared vertex and index
+/// arenas.
+///
+/// @param[in] vertices Vertex data, read by shaders through the vertex
+/// address.
+/// @param[in] vertices_size Size in bytes of the vertex data.
+/// @param[in] indices 32-bit indices relative to the first vertex.
+/// @param[in] index_count Number of indices.
+/// @param[in] optimize Removes duplicate vertices and reorders the mesh for
+/// the vertex cache, overdraw and vertex fetch, requires Vertex data.
+/// @returns mesh Reference to the mesh created, invalid if the mesh is larger
+/// than an arena or every arena is full, see is_valid.
+///
+/// @note Data must exist for atleast one frame (call to tgfx::frame).
+TUSK_API MeshHandle create_mesh(VertexLayoutHandle vlh,
+                                const void* vertices,
+                                uint32_t vertices_size,
+                                const uint32_t* indices,
+                                uint32_t index_count,
+                                bool optimize = false);
+
+/// @brief Releases the arena ranges of a mesh.
+///
+/// @note Ranges are reused once no frame in flight uses them.
+TUSK_API void destroy(MeshHandle mh);
+
 /// @brief Creates a texture given info.
 ///
 /// @param[in] info The parameters that define the texture.
 /// @returns texure Reference to texture that was created.
+///
+/// @note `num_layers` > 1 creates a texture array, `cube_map` creates a cube
+/// map (array) with 6 faces per layer. `depth` is ignored. Cube map arrays
+/// require imageCubeArray, without it their faces are viewed as a 2D array.
+///
+/// @note Data passed to `update` for streaming textures must contain the
+/// full, tightly packed mip chain and outlive the texture.
 TUSK_API TextureHandle create_texture_2d(const TextureInfo& info);
 
+/// @brief Creates a 3D texture given info.
+///
+/// @param[in] info The parameters that define the texture.
+/// @returns texure Reference to texture that was created.
+///
+/// @note `depth` must be greater than 1, use create_texture_2d otherwise.
+TUSK_API TextureHandle create_texture_3d(const TextureInfo& info);
+
+/// @brief Updates mip 0 of every layer of a texture, or the mip chain of a
+/// streaming texture.
+///
+/// @param[in] offset Must be 0, partial updates are not supported.
+/// @param[in] size Bytes of data, at least the size of what is updated.
 TUSK_API void update(TextureHandle th,
                      uint32_t offset,
                      uint32_t size,
                      void* data);
 
+/// @brief Updates a range of layers of a texture array or cube map.
+///
+/// @param[in] th Texture handle.
+/// @param[in] first_layer First layer to update, cube map faces are counted
+/// as layers (layer * 6 + face).
+/// @param[in] num_layers Number of layers to update.
+/// @param[in] data Tightly packed layers, must exist for atleast one frame.
+TUSK_API void update_layers(TextureHandle th,
+                            uint16_t first_layer,
+                            uint16_t num_layers,
+                            void* data);
+
 // @brief Releases the resources a texture.
 //
 /// @param[in] handle Handle to texture that will be invalidated.
+///
+/// @note The gpu image is destroyed once no frame in flight uses it.
 TUSK_API void destroy(TextureHandle th);
 
+/// @brief Reports the level of detail a streaming texture is sampled at.
+///
+/// @param[in] th Handle to a texture created with `TextureInfo::streaming`.
+/// @param[in] lod Most detailed mip level required this frame.
+///
+/// @note Requests are consumed every frame, textures not requested become
+/// candidates for eviction.
+TUSK_API void request_texture_lod(TextureHandle th, float lod);
+
+/// @brief Reports the screen space size a streaming texture is drawn at.
+///
+/// @param[in] th Handle to a texture created with `TextureInfo::streaming`.
+/// @param[in] screen_size Size in pixels of the largest texture dimension.
+TUSK_API void request_texture_size(TextureHandle th, float screen_size);
+
+/// @brief Sets the vram budget of streaming textures.
+///
+/// @param[in] bytes Budget in bytes, mips are evicted least recently used
+/// first once exceeded.
+TUSK_API void set_texture_budget(uint64_t bytes);
+
+/// @returns Texture streaming statistics of the last frame.
+TUSK_API TextureStreamingStats get_texture_streaming_stats();
+
+/// @brief Labels a buffer for memory attribution.
+///
+/// @note Resources bound to a descriptor are labelled with the descriptor
+/// name unless named explicitly.
+TUSK_API void set_name(BufferHandle bh, const char* name);
+
+/// @brief Labels a texture for memory attribution.
+TUSK_API void set_name(TextureHandle th, const char* name);
+
+/// @returns Per heap budget/usage and bytes allocated by category.
+TUSK_API MemoryStats get_memory_stats();
+
+/// @brief Lists the memory used by every live resource.
+///
+/// @param[out] infos Array to fill, may be null to query the count.
+/// @param[in] max_infos Capacity of infos.
+/// @returns Number of live resources.
+///
+/// @note Names are valid until the resource is destroyed or renamed.
+TUSK_API uint32_t get_resource_memory(ResourceMemoryInfo* infos,
+                                      uint32_t max_infos);
+
+/// @brief Sets a callback invoked when a heap's usage crosses a fraction of
+/// its budget.
+///
+/// @param[in] fn Callback, null to disable.
+/// @param[in] threshold Fraction of the budget in [0, 1].
+TUSK_API void set_memory_warning_callback(MemoryWarningFn fn, float threshold);
+
+/// @brief Starts incremental defragmentation of buffer and texture memory.
+///
+/// Allocations are moved over the following frames, each frame moving at most
+/// the given budget. Handles stay valid and device addresses are updated.
+///
+/// @param[in] max_bytes_per_frame Bytes moved per frame, 0 for no limit.
+/// @param[in] max_moves_per_frame Allocations moved per frame, 0 for no limit.
+/// @param[in] max_ms_per_frame Cpu time spent planning moves per frame, 0 for
+/// no limit.
+TUSK_API void defragment(uint64_t max_bytes_per_frame,
+                         uint32_t max_moves_per_frame,
+                         float max_ms_per_frame = 0.0f);
+
+/// @returns Progress of the current or last defragmentation.
+TUSK_API DefragmentationStats get_defragmentation_stats();
+
+/// @returns Counters of the descriptor set cache.
+TUSK_API DescriptorCacheStats get_descriptor_cache_stats();
+
+/// @brief Saves the pipeline cache to AppConfig::pipeline_cache_path, e.g.
+/// after loading a level. Also saved at shutdown.
+///
+/// @returns `true` if the cache was written.
+TUSK_API bool save_pipeline_cache();
+
+/// @returns Statistics of the persistent pipeline cache.
+TUSK_API PipelineCacheStats get_pipeline_cache_stats();
+
 /// @brief Binds view-projection matrix to draw call.
 ///
 /// @param[in] Ptr to view-projection matrix.
@@ -511,8 +980,28 @@ TUSK_API void set_vertex_buffer(BufferHandle vbh);
 
 TUSK_API void set_index_buffer(BufferHandle ibh);
 
+/// @brief Sets the mesh to draw, replacing vertex and index buffers.
+TUSK_API void set_mesh(MeshHandle mh);
+
+/// @brief Sets the uniforms of the draw.
+///
+/// Uniforms are sub-allocated from a per frame ring and read through
+/// descriptors of type k_uniform_buffer_dynamic created without a resource.
+///
+/// @param[in] data Uniform data, copied.
+/// @param[in] size Size in bytes, at most k_max_uniform_size.
+///
+/// @note Uniforms past k_max_frame_uniform_bytes in a frame are dropped.
+TUSK_API void set_uniform(const void* data, uint32_t size);
+
 TUSK_API void set_descriptor(DescriptorHandle dh);
 
+/// @brief Sets the fixed function state of the draw.
+///
+/// Opaque geometry should disable blending and draws that are occluded by
+/// nothing after them depth writes, to save fill-rate.
+TUSK_API void set_state(const RenderState& state);
+
 TUSK_API void submit(ProgramHandle ph);
 
 // ~ TODO: Internal ~
@@ -524,6 +1013,7 @@ struct DescriptorInfo {
   char name[256];
   uint16_t resource_handle_index;  //!< handle index to the resource this
                                    //!< descriptor is bound to.
+  SamplerInfo sampler;  //!< sampler of combined image samplers.
 
   inline const bool valid() const {
     return type != DescriptorType::k_max_enum ||
@@ -558,6 +1048,10 @@ struct RenderDraw {
   BufferHandle ibh;
   BufferHandle instbh;
 
+  MeshHandle mh;
+
+  uint32_t uniform_offset;  //!< offset of the draw's uniforms in the frame.
+
   ProgramHandle ph;
 
   uint32_t dh_count;
@@ -565,6 +1059,8 @@ struct RenderDraw {
 
   Rect2D viewport = {0.0f, 0.0f};
 
+  RenderState state;
+
   void clear() {
     viewproj_mtx[0] = 1.0f, viewproj_mtx[1] = 0.0f, viewproj_mtx[2] = 0.0f,
     viewproj_mtx[3] = 0.0f;  // 1st column
@@ -592,8 +1088,14 @@ struct RenderDraw {
     ibh = TUSK_INVALID_HANDLE;
     instbh = TUSK_INVALID_HANDLE;
 
+    mh = TUSK_INVALID_HANDLE;
+
+    uniform_offset = 0;
+
     ph = TUSK_INVALID_HANDLE;
 
+    state = {};
+
     dh_count = 0;
     // TODO: Change to memset in impl.
     for (auto& dh : dhs) {
@@ -605,6 +1107,10 @@ struct RenderDraw {
 struct Frame {
   uint32_t draw_count = 0;
   RenderDraw draws[k_max_draws] = {};
+
+  // Uniforms of all draws, copied to the uniform ring on submission.
+  uint32_t uniform_size = 0;
+  alignas(16) uint8_t uniform_data[k_max_frame_uniform_bytes] = {};
 };
 
 struct FrameBuffer {
@@ -0,0 +1,42 @@
+/**
+ * @file vertex_encoding.h
+ * @brief This file contains the encoders of vertex formats.
+ *
+ * @author Moka
+ * @date 2024-11-03
+ */
+
+#ifndef VERTEX_ENCODING_H_
+#define VERTEX_ENCODING_H_
+
+#include <tskgfx/tskgfx.h>
+
+namespace tsk {
+
+/*@brief Compressed vertex, see VertexEncoding::k_compressed.*/
+struct CompressedVertex {
+  uint16_t position[4];  // unorm16 in header bounds, w is padding.
+  int16_t normal[2];     // snorm16 octahedral.
+  uint16_t uv[2];        // half.
+};
+
+static_assert(sizeof(CompressedVertex) == 16, "Unexpected vertex size!");
+
+/// @returns Size in bytes of vertex_count encoded vertices, including the
+/// header.
+size_t encoded_vertices_size(VertexEncoding encoding, uint32_t vertex_count);
+
+/// @brief Encodes vertices.
+///
+/// @param[out] dst Destination of encoded_vertices_size bytes.
+void encode_vertices(VertexEncoding encoding,
+                     const Vertex* vertices,
+                     uint32_t vertex_count,
+                     void* dst);
+
+/// @returns The half precision bits of a float, rounded to nearest even.
+uint16_t float_to_half(float value);
+
+}  // namespace tsk
+
+#endif
@@ -0,0 +1,445 @@
+#include "tskgfx/mesh_opt.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace tsk {
+
+constexpr uint32_t k_invalid_index = UINT32_MAX;
+
+// ~ Duplicate Removal ~
+
+static uint32_t hash_vertex(const uint8_t* vertex, size_t vertex_size) {
+  // FNV-1a.
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < vertex_size; i++) {
+    hash = (hash ^ vertex[i]) * 16777619u;
+  }
+  return hash;
+}
+
+uint32_t generate_vertex_remap(uint32_t* remap,
+                               const void* vertices,
+                               uint32_t vertex_count,
+                               size_t vertex_size) {
+  const uint8_t* data = static_cast<const uint8_t*>(vertices);
+
+  // Open addressing table of vertex indices, kept under half full.
+  size_t table_size = 1;
+  while (table_size < size_t(vertex_count) * 2) {
+    table_size *= 2;
+  }
+  std::vector<uint32_t> table(table_size, k_invalid_index);
+
+  uint32_t unique_count = 0;
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    const uint8_t* vertex = data + i * vertex_size;
+
+    size_t slot = hash_vertex(vertex, vertex_size) & (table_size - 1);
+    while (table[slot] != k_invalid_index &&
+           memcmp(data + table[slot] * vertex_size, vertex, vertex_size) != 0) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+
+    if (table[slot] == k_invalid_index) {
+      table[slot] = i;
+      remap[i] = unique_count++;
+    } else {
+      remap[i] = remap[table[slot]];
+    }
+  }
+
+  return unique_count;
+}
+
+void remap_vertices(void* dst,
+                    const void* vertices,
+                    uint32_t vertex_count,
+                    size_t vertex_size,
+                    const uint32_t* remap) {
+  const uint8_t* src = static_cast<const uint8_t*>(vertices);
+  uint8_t* out = static_cast<uint8_t*>(dst);
+
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    memcpy(out + remap[i] * vertex_size, src + i * vertex_size, vertex_size);
+  }
+}
+
+void remap_indices(uint32_t* dst,
+                   const uint32_t* indices,
+                   size_t index_count,
+                   const uint32_t* remap) {
+  for (size_t i = 0; i < index_count; i++) {
+    dst[i] = remap[indices[i]];
+  }
+}
+
+// ~ Vertex Cache ~
+
+constexpr uint32_t k_forsyth_cache_size = 32;
+
+static float forsyth_vertex_score(int cache_position, uint32_t remaining) {
+  // Vertices without triangles left are never picked.
+  if (remaining == 0) {
+    return -1.0f;
+  }
+
+  float score = 0.0f;
+  if (cache_position >= 0) {
+    // The last triangle's vertices score equally to not favour an order.
+    if (cache_position < 3) {
+      score = 0.75f;
+    } else {
+      const float scaler = 1.0f / (k_forsyth_cache_size - 3);
+      score = std::pow(1.0f - (cache_position - 3) * scaler, 1.5f);
+    }
+  }
+
+  // Boost vertices with few triangles left to finish them off.
+  return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+}
+
+void optimize_vertex_cache(uint32_t* dst,
+                           const uint32_t* indices,
+                           size_t index_count,
+                           uint32_t vertex_count) {
+  assert(index_count % 3 == 0 && "Indices must form triangles!");
+
+  const size_t triangle_count = index_count / 3;
+  const std::vector<uint32_t> input(indices, indices + index_count);
+
+  // Triangles adjacent to each vertex, the first 'remaining' are not emitted.
+  std::vector<uint32_t> remaining(vertex_count, 0);
+  for (uint32_t index : input) {
+    remaining[index]++;
+  }
+
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  for (uint32_t v = 0; v < vertex_count; v++) {
+    offsets[v + 1] = offsets[v] + remaining[v];
+  }
+
+  std::vector<uint32_t> adjacency(index_count);
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t t = 0; t < triangle_count; t++) {
+    for (int k = 0; k < 3; k++) {
+      adjacency[fill[input[t * 3 + k]]++] = static_cast<uint32_t>(t);
+    }
+  }
+
+  std::vector<int> cache_position(vertex_count, -1);
+  std::vector<float> vertex_score(vertex_count);
+  for (uint32_t v = 0; v < vertex_count; v++) {
+    vertex_score[v] = forsyth_vertex_score(-1, remaining[v]);
+  }
+
+  std::vector<float> triangle_score(triangle_count);
+  std::vector<bool> emitted(triangle_count, false);
+  for (size_t t = 0; t < triangle_count; t++) {
+    triangle_score[t] = vertex_score[input[t * 3 + 0]] +
+                        vertex_score[input[t * 3 + 1]] +
+                        vertex_score[input[t * 3 + 2]];
+  }
+
+  uint32_t cache[k_forsyth_cache_size + 3];
+  uint32_t cache_count = 0;
+
+  size_t best = 0;
+  size_t input_cursor = 0;
+
+  for (size_t out = 0; out < triangle_count; out++) {
+    // Restart from the next triangle in input order if the cache dried up.
+    if (best == k_invalid_index) {
+      while (emitted[input_cursor]) {
+        input_cursor++;
+      }
+      best = input_cursor;
+    }
+
+    const uint32_t* triangle = &input[best * 3];
+    memcpy(dst + out * 3, triangle, 3 * sizeof(uint32_t));
+    emitted[best] = true;
+
+    // Emitted vertices move to the front of the cache.
+    uint32_t new_cache[k_forsyth_cache_size + 3];
+    uint32_t new_cache_count = 0;
+
+    for (int k = 0; k < 3; k++) {
+      const uint32_t v = triangle[k];
+      new_cache[new_cache_count++] = v;
+
+      uint32_t* adjacent = &adjacency[offsets[v]];
+      uint32_t* last = adjacent + remaining[v] - 1;
+      std::iter_swap(std::find(adjacent, last, uint32_t(best)), last);
+      remaining[v]--;
+    }
+
+    for (uint32_t i = 0; i < cache_count; i++) {
+      const uint32_t v = cache[i];
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        new_cache[new_cache_count++] = v;
+      }
+    }
+
+    for (uint32_t i = 0; i < new_cache_count; i++) {
+      const uint32_t v = new_cache[i];
+      cache_position[v] = i < k_forsyth_cache_size ? int(i) : -1;
+      vertex_score[v] = forsyth_vertex_score(cache_position[v], remaining[v]);
+    }
+
+    // Rescore triangles touching the cache and pick the best.
+    best = k_invalid_index;
+    float best_score = -1.0f;
+
+    for (uint32_t i = 0; i < new_cache_count; i++) {
+      const uint32_t v = new_cache[i];
+      for (uint32_t a = 0; a < remaining[v]; a++) {
+        const uint32_t t = adjacency[offsets[v] + a];
+        triangle_score[t] = vertex_score[input[t * 3 + 0]] +
+                            vertex_score[input[t * 3 + 1]] +
+                            vertex_score[input[t * 3 + 2]];
+
+        if (triangle_score[t] > best_score) {
+          best_score = triangle_score[t];
+          best = t;
+        }
+      }
+    }
+
+    cache_count = std::min(new_cache_count, k_forsyth_cache_size);
+    memcpy(cache, new_cache, cache_count * sizeof(uint32_t));
+  }
+}
+
+// ~ Overdraw ~
+
+/// @returns Number of vertices of the triangle missing the FIFO cache.
+static uint32_t simulate_fifo(const uint32_t* triangle,
+                              std::vector<uint32_t>& timestamps,
+                              uint32_t& time,
+                              uint32_t cache_size) {
+  uint32_t misses = 0;
+  for (int k = 0; k < 3; k++) {
+    const uint32_t v = triangle[k];
+    if (time - timestamps[v] > cache_size) {
+      timestamps[v] = time++;
+      misses++;
+    }
+  }
+  return misses;
+}
+
+void optimize_overdraw(uint32_t* dst,
+                       const uint32_t* indices,
+                       size_t index_count,
+                       const float* positions,
+                       uint32_t vertex_count,
+                       size_t vertex_stride,
+                       float threshold) {
+  assert(index_count % 3 == 0 && "Indices must form triangles!");
+
+  const size_t triangle_count = index_count / 3;
+  const std::vector<uint32_t> input(indices, indices + index_count);
+
+  auto position = [&](uint32_t v) {
+    return reinterpret_cast<const float*>(
+        reinterpret_cast<const uint8_t*>(positions) + v * vertex_stride);
+  };
+
+  // Shared by the simulations, advancing time past the cache size empties
+  // the cache without clearing the timestamps.
+  std::vector<uint32_t> timestamps(vertex_count, 0);
+  uint32_t time = k_vertex_cache_size + 1;
+
+  // Hard boundaries where every vertex of a triangle misses the cache.
+  std::vector<size_t> clusters;
+  for (size_t t = 0; t < triangle_count; t++) {
+    if (simulate_fifo(&input[t * 3], timestamps, time, k_vertex_cache_size) ==
+        3) {
+      clusters.push_back(t);
+    }
+  }
+
+  if (clusters.empty() || clusters[0] != 0) {
+    clusters.insert(clusters.begin(), 0);
+  }
+
+  // Soft boundaries inside hard clusters where the ACMR so far stays within
+  // threshold of the cluster's.
+  std::vector<size_t> soft_clusters;
+  for (size_t c = 0; c < clusters.size(); c++) {
+    const size_t begin = clusters[c];
+    const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+    time += k_vertex_cache_size + 1;
+
+    std::vector<uint32_t> misses(end - begin);
+    uint32_t cluster_misses = 0;
+    for (size_t t = begin; t < end; t++) {
+      misses[t - begin] =
+          simulate_fifo(&input[t * 3], timestamps, time, k_vertex_cache_size);
+      cluster_misses += misses[t - begin];
+    }
+
+    const float cluster_acmr = float(cluster_misses) / float(end - begin);
+
+    soft_clusters.push_back(begin);
+
+    size_t start = begin;
+    uint32_t running_misses = 0;
+    for (size_t t = begin; t < end; t++) {
+      running_misses += misses[t - begin];
+
+      const float running_acmr = float(running_misses) / float(t - start + 1);
+      if (t + 1 < end && running_acmr <= cluster_acmr * threshold &&
+          misses[t + 1 - begin] >= 2) {
+        soft_clusters.push_back(t + 1);
+        start = t + 1;
+        running_misses = 0;
+      }
+    }
+  }
+
+  // Mesh centroid.
+  float mesh_centroid[3] = {};
+  for (size_t i = 0; i < index_count; i++) {
+    const float* p = position(input[i]);
+    for (int k = 0; k < 3; k++) {
+      mesh_centroid[k] += p[k] / float(index_count);
+    }
+  }
+
+  // Sort clusters by how much they face away from the mesh centre.
+  const size_t cluster_count = soft_clusters.size();
+  std::vector<float> sort_keys(cluster_count);
+
+  for (size_t c = 0; c < cluster_count; c++) {
+    const size_t begin = soft_clusters[c];
+    const size_t end =
+        c + 1 < cluster_count ? soft_clusters[c + 1] : triangle_count;
+
+    float centroid[3] = {};
+    float normal[3] = {};
+    float area = 0.0f;
+
+    for (size_t t = begin; t < end; t++) {
+      const float* p0 = position(input[t * 3 + 0]);
+      const float* p1 = position(input[t * 3 + 1]);
+      const float* p2 = position(input[t * 3 + 2]);
+
+      const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+      const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+      const float n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                          e1[2] * e2[0] - e1[0] * e2[2],
+                          e1[0] * e2[1] - e1[1] * e2[0]};
+      const float twice_area =
+          std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+      for (int k = 0; k < 3; k++) {
+        centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * twice_area;
+        normal[k] += n[k];
+      }
+      area += twice_area;
+    }
+
+    const float inv_area = area > 0.0f ? 1.0f / area : 0.0f;
+    const float normal_length = std::sqrt(
+        normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    const float inv_normal_length =
+        normal_length > 0.0f ? 1.0f / normal_length : 0.0f;
+
+    float key = 0.0f;
+    for (int k = 0; k < 3; k++) {
+      key += (centroid[k] * inv_area - mesh_centroid[k]) * normal[k] *
+             inv_normal_length;
+    }
+    sort_keys[c] = key;
+  }
+
+  std::vector<size_t> order(cluster_count);
+  for (size_t c = 0; c < cluster_count; c++) {
+    order[c] = c;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return sort_keys[a] > sort_keys[b];
+  });
+
+  size_t out = 0;
+  for (size_t c : order) {
+    const size_t begin = soft_clusters[c];
+    const size_t end =
+        c + 1 < cluster_count ? soft_clusters[c + 1] : triangle_count;
+
+    memcpy(dst + out, &input[begin * 3], (end - begin) * 3 * sizeof(uint32_t));
+    out += (end - begin) * 3;
+  }
+}
+
+// ~ Vertex Fetch ~
+
+uint32_t optimize_vertex_fetch(void* dst,
+                               uint32_t* indices,
+                               size_t index_count,
+                               const void* vertices,
+                               uint32_t vertex_count,
+                               size_t vertex_size) {
+  const uint8_t* src = static_cast<const uint8_t*>(vertices);
+  uint8_t* out = static_cast<uint8_t*>(dst);
+
+  std::vector<uint32_t> remap(vertex_count, k_invalid_index);
+  uint32_t next = 0;
+
+  for (size_t i = 0; i < index_count; i++) {
+    const uint32_t v = indices[i];
+    if (remap[v] == k_invalid_index) {
+      memcpy(out + next * vertex_size, src + v * vertex_size, vertex_size);
+      remap[v] = next++;
+    }
+
+    indices[i] = remap[v];
+  }
+
+  return next;
+}
+
+// ~ Analysis ~
+
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices,
+                                      size_t index_count,
+                                      uint32_t vertex_count,
+                                      uint32_t cache_size) {
+  VertexCacheStats stats = {};
+
+  std::vector<uint32_t> timestamps(vertex_count, 0);
+  std::vector<bool> referenced(vertex_count, false);
+  uint32_t referenced_count = 0;
+  uint32_t time = cache_size + 1;
+
+  for (size_t t = 0; t < index_count / 3; t++) {
+    stats.vertices_transformed +=
+        simulate_fifo(&indices[t * 3], timestamps, time, cache_size);
+
+    for (int k = 0; k < 3; k++) {
+      const uint32_t v = indices[t * 3 + k];
+      if (!referenced[v]) {
+        referenced[v] = true;
+        referenced_count++;
+      }
+    }
+  }
+
+  const size_t triangle_count = index_count / 3;
+  stats.acmr = triangle_count > 0
+                   ? float(stats.vertices_transformed) / float(triangle_count)
+                   : 0.0f;
+  stats.atvr = referenced_count > 0 ? float(stats.vertices_transformed) /
+                                          float(referenced_count)
+                                    : 0.0f;
+
+  return stats;
+}
+
+}  // namespace tsk
@@ -6,14 +6,24 @@
 #include <vulkan/vulkan_core.h>
 
 #include "tskgfx/renderer.h"
+#include "tskgfx/shader_pack.h"
 #include "tskgfx/spirv.h"
+#include "tskgfx/thread_pool.h"
 #include "tskgfx/tskgfx.h"
 
 #define VMA_IMPLEMENTATION
 #include <assert.h>
 #include <vma/vk_mem_alloc.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #ifdef TUSK_DEBUG
 #define VK_CHECK(call)                                      \
@@ -116,6 +126,66 @@ static void copy_image_to_image(VkCommandBuffer cmd,
   vkCmdBlitImage2(cmd, &blit_info);
 }
 
+/// @returns Size in bytes of a texel of an uncompressed format.
+static uint32_t format_texel_size(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R8_SNORM:
+    case VK_FORMAT_R8_UINT:
+    case VK_FORMAT_R8_SINT:
+    case VK_FORMAT_R8_SRGB:
+      return 1;
+
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R8G8_SNORM:
+    case VK_FORMAT_R8G8_UINT:
+    case VK_FORMAT_R8G8_SINT:
+    case VK_FORMAT_R8G8_SRGB:
+    case VK_FORMAT_R16_UNORM:
+    case VK_FORMAT_R16_UINT:
+    case VK_FORMAT_R16_SFLOAT:
+    case VK_FORMAT_D16_UNORM:
+      return 2;
+
+    case VK_FORMAT_R16G16B16A16_UNORM:
+    case VK_FORMAT_R16G16B16A16_UINT:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_UINT:
+    case VK_FORMAT_R32G32_SFLOAT:
+      return 8;
+
+    case VK_FORMAT_R32G32B32A32_UINT:
+    case VK_FORMAT_R32G32B32A32_SINT:
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return 16;
+
+    default:
+      return 4;
+  }
+}
+
+/// @returns Extent of a mip level.
+static VkExtent3D mip_extent(VkExtent3D extent, uint32_t mip) {
+  return {std::max(extent.width >> mip, 1u),
+          std::max(extent.height >> mip, 1u),
+          std::max(extent.depth >> mip, 1u)};
+}
+
+/// @returns Size in bytes of the tightly packed mips [first_mip, last_mip).
+static VkDeviceSize mip_chain_size(VkExtent3D extent,
+                                   VkFormat format,
+                                   uint32_t first_mip,
+                                   uint32_t last_mip) {
+  VkDeviceSize size = 0;
+  for (uint32_t mip = first_mip; mip < last_mip; mip++) {
+    const VkExtent3D level = mip_extent(extent, mip);
+    size += VkDeviceSize(level.width) * level.height * level.depth *
+            format_texel_size(format);
+  }
+
+  return size;
+}
+
 namespace tsk {
 
 class RenderContextVk : public RenderContextI {
@@ -127,17 +197,29 @@ class RenderContextVk : public RenderContextI {
   virtual void shutdown() override;
   virtual void frame() override;
 
-  virtual void create_texture_2d(TextureHandle handle,
-                                 const TextureInfo& info) override;
+  virtual void create_texture(TextureHandle handle,
+                              const TextureInfo& info) override;
+
+  virtual void update_texture(TextureHandle th,
+                              uint32_t offset,
+                              uint32_t size,
+                              void* data) override;
 
-  virtual void update_texture_2d(TextureHandle th,
-                                 uint32_t offset,
-                                 uint32_t size,
-                                 void* data) override;
+  virtual void update_texture_layers(TextureHandle th,
+                                     uint16_t first_layer,
+                                     uint16_t num_layers,
+                                     void* data) override;
 
   virtual void destroy(TextureHandle handle) override;
 
-  virtual void create_shader(ShaderHandle handle, const char* path) override;
+  virtual void request_texture_lod(TextureHandle th, float lod) override;
+  virtual void request_texture_size(TextureHandle th,
+                                    float screen_size) override;
+  virtual void set_texture_budget(uint64_t bytes) override;
+  virtual TextureStreamingStats get_texture_streaming_stats() override;
+
+  virtual ShaderHandle create_shader(ShaderHandle handle,
+                                     const char* path) override;
 
   virtual void destroy(ShaderHandle sh) override;
 
@@ -152,7 +234,11 @@ class RenderContextVk : public RenderContextI {
   virtual void create_descriptor(DescriptorHandle dh,
                                  DescriptorType type,
                                  uint16_t num,
+                                 const SamplerInfo& sampler,
                                  const char* name) override;
+  virtual void destroy(DescriptorHandle dh) override;
+
+  virtual uint32_t get_bindless_sampler(const SamplerInfo& sampler) override;
 
   virtual void create_uniform_buffer(BufferHandle bh,
                                      uint32_t size,
@@ -173,6 +259,40 @@ class RenderContextVk : public RenderContextI {
 
   virtual void destroy(BufferHandle bh) override;
 
+  virtual bool create_mesh(MeshHandle mh,
+                           const void* vertices,
+                           uint32_t vertices_size,
+                           const uint32_t* indices,
+                           uint32_t index_count) override;
+  virtual void destroy(MeshHandle mh) override;
+
+  virtual void set_name(BufferHandle bh, const char* name) override;
+  virtual void set_name(TextureHandle th, const char* name) override;
+  virtual MemoryStats get_memory_stats() override;
+  virtual uint32_t get_resource_memory(ResourceMemoryInfo* infos,
+                                       uint32_t max_infos) override;
+  virtual void set_memory_warning_callback(MemoryWarningFn fn,
+                                           float threshold) override;
+
+  virtual void defragment(uint64_t max_bytes_per_frame,
+                          uint32_t max_moves_per_frame,
+                          float max_ms_per_frame) override;
+  virtual DefragmentationStats get_defragmentation_stats() override;
+  virtual DescriptorCacheStats get_descriptor_cache_stats() override;
+
+  virtual bool is_ready(ProgramHandle ph) override;
+  virtual void set_fallback_program(ProgramHandle ph) override;
+  virtual ProgramHandle create_program_variant(
+      ProgramHandle variant,
+      ProgramHandle ph,
+      const SpecializationConstant* constants,
+      uint32_t count) override;
+  virtual uint32_t get_specialization_constants(ProgramHandle ph,
+                                                uint32_t* ids) override;
+
+  virtual bool save_pipeline_cache() override;
+  virtual PipelineCacheStats get_pipeline_cache_stats() override;
+
   virtual void submit(Frame* frame) override;
 
  private:
@@ -228,12 +348,44 @@ VkSemaphore render_semaphores[k_frame_overlap];
 VkSemaphore swapchain_semaphore[k_frame_overlap];
 VkFence render_fence[k_frame_overlap];
 int current_frame;
+uint64_t frame_number = 0;
+
+// Objects released per frame context, see 'retire'. Objects released while
+// recording go to the recording context, otherwise to the context submitted
+// last, the newest work that may reference them.
+DeletionQueueVk deletion_queues[k_frame_overlap];
+bool recording_frame = false;
+int submitted_frame = 0;
 
 // Rendering resources.
 VmaAllocator allocator;
+VkDeviceSize memory_category_bytes[uint32_t(MemoryCategory::k_count)] = {};
+
+MemoryWarningFn memory_warning_fn = nullptr;
+float memory_warning_threshold = 0.9f;
+uint32_t memory_warning_heaps = 0;  // Heaps over threshold, warned once.
+
 TextureVk final_color_texture;
 TextureVk final_depth_texture;
 
+// Defragmentation, a pass recorded in a frame context ends once it retires.
+VmaDefragmentationContext defrag_context = VK_NULL_HANDLE;
+VmaDefragmentationPassMoveInfo defrag_pass = {};
+int defrag_pass_frame = -1;
+float defrag_max_ms = 0.0f;
+std::chrono::steady_clock::time_point defrag_pass_start;
+DefragmentationStats defrag_stats = {};
+
+std::vector<VkBuffer> defrag_old_buffers;
+std::vector<VkImage> defrag_old_images;
+std::vector<VkImageView> defrag_old_image_views;
+
+// User data of cached allocations, the cache in the high bits and the handle
+// in the low 16 so moves find their resource without scanning the caches.
+// Allocations without user data are not moved.
+constexpr uintptr_t k_defrag_buffer_owner = uintptr_t(1) << 16;
+constexpr uintptr_t k_defrag_texture_owner = uintptr_t(2) << 16;
+
 void (*imgui_draw_fn)(VkCommandBuffer) = nullptr;
 
 // Descriptors.
@@ -241,13 +393,71 @@ VkDescriptorPool descriptor_pool;
 
 // ~ Resources ~
 
-// [Resource] : pipelines.
-std::unordered_map<VkPipelineLayout, VkPipeline> pipeline_cache;
+// [Resource] : pipelines, a permutation per program and render state.
+struct PipelineKeyHashVk {
+  size_t operator()(const PipelineKeyVk& key) const {
+    uint32_t hash;
+    tsk::murmur_hash3_x86_32(&key, sizeof(key), 0, &hash);
+    return hash;
+  }
+};
+
+std::unordered_map<PipelineKeyVk, VkPipeline, PipelineKeyHashVk> pipeline_cache;
+
+// Pipelines compile on the workers, finished jobs are collected on the render
+// thread by collect_pipelines.
+ThreadPool pipeline_workers;
+std::mutex compiled_pipelines_mutex;
+std::vector<PipelineJobVk*> compiled_pipelines;
+std::unordered_map<PipelineKeyVk, PipelineJobVk*, PipelineKeyHashVk>
+    pending_pipelines;
+ProgramHandle fallback_ph;
+VkPipeline draw_pipelines[k_max_draws] = {};  // Resolved per draw.
+
+// Programs and jobs referencing each shader module, modules destroyed while
+// referenced are kept until released.
+std::unordered_map<VkShaderModule, uint32_t> shader_module_refs;
+std::vector<VkShaderModule> retired_shader_modules;
+
+// Layouts of destroyed programs retired by collect_pipelines once their last
+// pipeline compiled.
+std::vector<VkPipelineLayout> retired_pipeline_layouts;
+
+// Variants by base program index and hash of their constants.
+std::unordered_map<uint64_t, ProgramHandle> program_variants;
+
+// Driver cache pipelines are created with, persisted to pipeline_cache_path.
+VkPipelineCache device_pipeline_cache = VK_NULL_HANDLE;
+std::string pipeline_cache_path;
+PipelineCacheHeaderVk pipeline_cache_header = {};  // Of the current device.
+PipelineCacheStats pipeline_cache_stats = {};
+
+// [Resource] : pso usage, pipelines drawn are recorded to pso_usage_path at
+// shutdown. Those recorded by the last run are requested when their program is
+// created and polled by warm_up_pipelines until ready.
+struct PsoUsageHashVk {
+  size_t operator()(const PsoUsageVk& usage) const {
+    uint32_t hash;
+    tsk::murmur_hash3_x86_32(&usage, sizeof(usage), 0, &hash);
+    return hash;
+  }
+};
+
+std::string pso_usage_path;
+std::unordered_set<PsoUsageVk, PsoUsageHashVk> pso_usage;  // Of this run.
+std::vector<PsoUsageVk> recorded_pso_usage;  // Of the last run.
+std::vector<std::pair<ProgramHandle, uint32_t>> warming_pipelines;
+std::chrono::steady_clock::time_point warmup_start;
 
 // [Resource] : shader programs.
 ProgramVk program_cache[512] = {};
 ShaderVk shader_cache[512] = {};
 
+// Shaders by ShaderVk::content_key, identical SPIR-V shares one module and
+// its reflection.
+std::unordered_multimap<uint64_t, ShaderHandle> shader_handles;
+ShaderPack shader_pack;  // See AppConfig::shader_pack_path.
+
 // [Resource] : buffers.
 BufferVk buffer_cache[512] = {};
 
@@ -255,30 +465,297 @@ BufferHandle dirty_buffers[512] = {};
 void* buffer_data_ptrs[512] = {};
 int dirty_buffers_head = 0;
 
-BufferVk transient_buffers[512] = {};
-int transient_buffer_count = 0;
+// [Resource] : uniform ring, a region of k_max_frame_uniform_bytes per frame
+// context, padded so any dynamic offset can bind k_max_uniform_size bytes.
+BufferVk uniform_ring;
+uint8_t* uniform_ring_data = nullptr;
+
+// [Resource] : descriptor buffer, with VK_EXT_descriptor_buffer the
+// descriptors of each draw are written to a region per frame context instead
+// of cached sets.
+bool descriptor_buffer_enabled = false;
+VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptor_buffer_properties = {};
+BufferVk descriptor_buffer;
+uint8_t* descriptor_buffer_data = nullptr;
+VkDeviceSize descriptor_buffer_head = 0;  // Bytes written this frame.
+VkDeviceSize descriptor_buffer_frame_size = k_descriptor_buffer_frame_size;
+
+PFN_vkGetDescriptorSetLayoutSizeEXT pfn_vkGetDescriptorSetLayoutSizeEXT;
+PFN_vkGetDescriptorSetLayoutBindingOffsetEXT
+    pfn_vkGetDescriptorSetLayoutBindingOffsetEXT;
+PFN_vkGetDescriptorEXT pfn_vkGetDescriptorEXT;
+PFN_vkCmdBindDescriptorBuffersEXT pfn_vkCmdBindDescriptorBuffersEXT;
+PFN_vkCmdSetDescriptorBufferOffsetsEXT pfn_vkCmdSetDescriptorBufferOffsetsEXT;
+
+// [Resource] : push descriptors, small program sets are pushed per draw
+// with VK_KHR_push_descriptor instead of cached sets.
+bool push_descriptor_enabled = false;
+uint32_t push_descriptor_programs = 0;
+
+PFN_vkCmdPushDescriptorSetWithTemplateKHR
+    pfn_vkCmdPushDescriptorSetWithTemplateKHR;
+
+// [Resource] : dynamic render state, bits of a packed RenderState set per
+// draw instead of compiled into pipelines, see AppConfig::dynamic_state.
+uint32_t dynamic_state_bits = 0;
+bool dynamic_topology_unrestricted = false;  // Else per topology class.
+
+PFN_vkCmdSetColorBlendEnableEXT pfn_vkCmdSetColorBlendEnableEXT;
+PFN_vkCmdSetColorBlendEquationEXT pfn_vkCmdSetColorBlendEquationEXT;
+
+// [Resource] : pipeline libraries, with VK_EXT_graphics_pipeline_library the
+// parts of a pipeline compile once per shader or state into pipeline_cache,
+// see library_key. Permutations are fast linked from them on first use and
+// replaced by an optimized link compiled on the pipeline workers.
+bool pipeline_library_enabled = false;
+
+// Libraries of destroyed programs, retired once no job links them.
+std::vector<std::pair<VkPipelineLayout, VkPipeline>> retired_pipeline_libraries;
+
+// [Resource] : meshes.
+MeshArenaVk mesh_arenas[k_max_mesh_arenas] = {};
+int mesh_arena_count = 0;
+
+MeshVk mesh_cache[512] = {};
+
+struct MeshUpdateVk {
+  MeshHandle mh;
+  const void* vertices;
+  uint32_t vertices_size;
+  const uint32_t* indices;
+};
 
-int transient_buffer_destroy_queue[512] = {};
-int transient_buffer_destroy_queue_count = 0;
+MeshUpdateVk dirty_meshes[512] = {};
+int dirty_meshes_head = 0;
 
 // [Resource] : textures
 TextureVk texture_cache[512] = {};
 
-TextureHandle dirty_textures[512] = {};
-void* texture_data_ptrs[512] = {};
+struct TextureUpdateVk {
+  TextureHandle th;
+  uint16_t first_layer;
+  uint16_t num_layers;  // UINT16_MAX updates all layers.
+  void* data;
+};
+
+TextureUpdateVk dirty_textures[512] = {};
 int dirty_textures_head = 0;
 
+// [Resource] : streaming textures.
+StreamingTextureVk texture_streams[512] = {};
+TextureHandle streaming_textures[512] = {};
+int streaming_textures_count = 0;
+
+VkDeviceSize texture_budget = 256ull * 1024 * 1024;
+VkDeviceSize texture_resident_bytes = 0;
+TextureStreamingStats texture_streaming_stats = {};
+
 // [Resource] : descriptors.
 DescriptorInfo descriptor_set_info_cache[512] = {};
-std::unordered_map<uint32_t, VkDescriptorSet> ds_set_cache;
 
-// [Resources] : samplers
-// TODO: Turn into sampler desc hash to Sampler.
-VkSampler texture_sampler_cache[512] = {VK_NULL_HANDLE};
+/*@brief Content of a descriptor set, compared bytewise.*/
+struct DescriptorSetKeyVk {
+  VkDescriptorSetLayout layout;
+  uint64_t resources[k_max_desciptors];  // Bound VkBuffer or VkImageView.
+  DescriptorHandle dhs[k_max_desciptors];
+  uint32_t dh_count;
+
+  bool operator==(const DescriptorSetKeyVk& other) const {
+    return memcmp(this, &other, sizeof(DescriptorSetKeyVk)) == 0;
+  }
+};
+
+struct DescriptorSetKeyHashVk {
+  size_t operator()(const DescriptorSetKeyVk& key) const {
+    uint32_t hash;
+    tsk::murmur_hash3_x86_32(&key, sizeof(key), 0, &hash);
+    return hash;
+  }
+};
+
+struct DescriptorSetVk {
+  DescriptorSetAllocationVk allocation;
+  uint64_t last_used_frame;
+};
+
+std::unordered_map<DescriptorSetKeyVk, DescriptorSetVk, DescriptorSetKeyHashVk>
+    ds_set_cache;
+
+// Pools sets are allocated from, a pool is appended once all are exhausted.
+std::vector<VkDescriptorPool> descriptor_pools;
+
+// Descriptors per type summed over the programs allocating from pools, and
+// the most of a single set. Sizes the pools appended to the chain.
+uint32_t pool_descriptor_totals[k_descriptor_type_count] = {};
+uint32_t pool_descriptor_max[k_descriptor_type_count] = {};
+uint32_t pool_programs = 0;
+DescriptorCacheStats descriptor_cache_stats = {};
+
+// [Resources] : samplers, deduplicated by description.
+struct SamplerVk {
+  VkSampler sampler;
+  uint32_t bindless_index;  // Index in the bindless sampler array.
+};
+
+struct SamplerInfoHashVk {
+  size_t operator()(const SamplerInfo& info) const {
+    uint32_t hash;
+    tsk::murmur_hash3_x86_32(&info, sizeof(info), 0, &hash);
+    return hash;
+  }
+};
+
+struct SamplerInfoEqualVk {
+  bool operator()(const SamplerInfo& a, const SamplerInfo& b) const {
+    return memcmp(&a, &b, sizeof(SamplerInfo)) == 0;
+  }
+};
+
+std::unordered_map<SamplerInfo,
+                   SamplerVk,
+                   SamplerInfoHashVk,
+                   SamplerInfoEqualVk>
+    sampler_cache;
+float max_sampler_anisotropy = 0.0f;  // 0 if anisotropy is unsupported.
+bool cube_array_enabled = false;      // Views of more than one cube.
+
+// [Resource] : bindless, textures and storage buffers indexed by handle. Each
+// frame context has its own set, changed slots are written to a set the next
+// time its context records so sets in flight are never updated.
+VkDescriptorSetLayout bindless_set_layout = VK_NULL_HANDLE;
+VkPipelineLayout bindless_pipeline_layout = VK_NULL_HANDLE;
+VkDescriptorPool bindless_pool = VK_NULL_HANDLE;
+VkDescriptorSet bindless_sets[k_frame_overlap] = {};
+
+std::vector<TextureHandle> bindless_dirty_textures[k_frame_overlap];
+std::vector<BufferHandle> bindless_dirty_buffers[k_frame_overlap];
+std::vector<SamplerVk> bindless_dirty_samplers[k_frame_overlap];
 
 // Default resources.
 tsk::TextureHandle white_rgba_th;
 
+/// @brief Cancels the move of an allocation destroyed while its
+/// defragmentation pass is in flight.
+///
+/// @returns 'true' if the allocation is now released by the pass and must not
+/// be freed.
+static bool defrag_release(VmaAllocation allocation) {
+  if (defrag_pass_frame == -1) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < defrag_pass.moveCount; i++) {
+    VmaDefragmentationMove& move = defrag_pass.pMoves[i];
+    if (move.srcAllocation == allocation &&
+        move.operation == VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY) {
+      move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// @brief Marks the allocation of a cached resource as owned by its handle.
+static void set_defrag_owner(VmaAllocation allocation,
+                             uintptr_t owner,
+                             uint16_t handle) {
+  vmaSetAllocationUserData(
+      allocator, allocation, reinterpret_cast<void*>(owner | handle));
+}
+
+/// @returns The deletion queue of the newest frame that may use released
+/// objects.
+static DeletionQueueVk& deletion_queue() {
+  return deletion_queues[recording_frame ? current_frame : submitted_frame];
+}
+
+/// @brief Queues objects for destruction once no frame in flight uses them.
+static void retire(const BufferVk& buffer) {
+  deletion_queue().buffers.push_back(buffer);
+}
+
+static void retire(const TextureVk& texture) {
+  deletion_queue().textures.push_back(texture);
+}
+
+static void retire(const DescriptorSetAllocationVk& allocation) {
+  deletion_queue().descriptor_sets.push_back(allocation);
+}
+
+/// @brief Queues the bindless slot of a texture whose view changed.
+static void bindless_dirty(TextureHandle th) {
+  if (!config.bindless) {
+    return;
+  }
+
+  for (auto& dirty_textures : bindless_dirty_textures) {
+    dirty_textures.push_back(th);
+  }
+}
+
+/// @returns Usage buffers need to be written to the bindless buffer array.
+static VkBufferUsageFlags bindless_buffer_usage() {
+  return config.bindless ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0;
+}
+
+/// @brief Queues the bindless slot of a buffer that changed.
+static void bindless_dirty(BufferHandle bh) {
+  if (!config.bindless) {
+    return;
+  }
+
+  for (auto& dirty_buffers : bindless_dirty_buffers) {
+    dirty_buffers.push_back(bh);
+  }
+}
+
+/// @returns The sampler of the description, created on first use.
+static const SamplerVk& get_sampler(const SamplerInfo& info) {
+  auto it = sampler_cache.find(info);
+  if (it != sampler_cache.end()) {
+    return it->second;
+  }
+
+  VkSamplerCreateInfo sampler_info = {};
+  sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sampler_info.minFilter = VkFilter(info.min_filter);
+  sampler_info.magFilter = VkFilter(info.mag_filter);
+  sampler_info.mipmapMode = VkSamplerMipmapMode(info.mip_mode);
+
+  sampler_info.addressModeU = VkSamplerAddressMode(info.address_u);
+  sampler_info.addressModeV = VkSamplerAddressMode(info.address_v);
+  sampler_info.addressModeW = VkSamplerAddressMode(info.address_w);
+
+  sampler_info.mipLodBias = info.mip_lod_bias;
+  sampler_info.minLod = info.min_lod;
+  sampler_info.maxLod = info.max_lod;
+
+  // Clamped to the device, disabled if unsupported.
+  const float anisotropy =
+      std::min(info.max_anisotropy, max_sampler_anisotropy);
+  sampler_info.anisotropyEnable = anisotropy > 1.0f;
+  sampler_info.maxAnisotropy = std::max(anisotropy, 1.0f);
+
+  sampler_info.compareEnable = info.compare;
+  sampler_info.compareOp = VkCompareOp(info.compare_op);
+
+  SamplerVk sampler = {};
+  sampler.bindless_index = static_cast<uint32_t>(sampler_cache.size());
+  VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr, &sampler.sampler));
+
+  if (config.bindless) {
+    assert(sampler.bindless_index < k_max_bindless_samplers &&
+           "Exceeded bindless samplers!");
+
+    for (auto& dirty_samplers : bindless_dirty_samplers) {
+      dirty_samplers.push_back(sampler);
+    }
+  }
+
+  return sampler_cache.emplace(info, sampler).first->second;
+}
+
 inline const VkDeviceSize BufferVk::allocated_size() const {
   return allocation->GetSize();
 }
@@ -315,6 +792,14 @@ void BufferVk::create(VkBufferUsageFlags usage,
                            &allocation,
                            nullptr));
 
+  this->usage = usage;
+
+  // Attribute memory, mappable transfer sources are staging buffers.
+  category = mappable && usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                 ? MemoryCategory::k_staging
+                 : MemoryCategory::k_buffer;
+  memory_category_bytes[uint32_t(category)] += allocated_size();
+
   // Update address if requested.
   if ((usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ==
       VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
@@ -352,15 +837,17 @@ void BufferVk::update(VkCommandBuffer cmd,
     return;
   }
 
-  // Create transient buffer to be destroyed at end of frame.
-  BufferVk& staging_buffer = transient_buffers[transient_buffer_count++];
+  // Create transient buffer to be destroyed once the copy has completed.
+  BufferVk staging_buffer;
   staging_buffer.create(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, true);
 
   void* mapped_data;
   VK_CHECK(vmaMapMemory(allocator, staging_buffer.allocation, &mapped_data));
-  memcpy(static_cast<char*>(mapped_data) + offset, data, size);
+  memcpy(mapped_data, data, size);
   vmaUnmapMemory(allocator, staging_buffer.allocation);
 
+  retire(staging_buffer);
+
   // Buffer copy command.
   {
     VkBufferCopy copy_region = {};
@@ -390,48 +877,153 @@ void BufferVk::update(VkCommandBuffer cmd,
     vkCmdPipelineBarrier2(cmd, &dependency_info);
   }
 }
+void BufferVk::set_name(const char* name) {
+  vmaSetAllocationName(allocator, allocation, name);
+}
+
+const char* BufferVk::name() const {
+  VmaAllocationInfo info = {};
+  vmaGetAllocationInfo(allocator, allocation, &info);
+  return info.pName;
+}
+
+void* BufferVk::mapped_data() const {
+  VmaAllocationInfo allocation_info = {};
+  vmaGetAllocationInfo(allocator, allocation, &allocation_info);
+  return allocation_info.pMappedData;
+}
+
+VkBuffer BufferVk::move(VkCommandBuffer cmd, VmaAllocation dst_allocation) {
+  VkBufferCreateInfo buffer_create_info = {};
+  buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_create_info.size = device_size;
+  buffer_create_info.usage = usage;
+
+  VkBuffer moved = VK_NULL_HANDLE;
+  VK_CHECK(vkCreateBuffer(device, &buffer_create_info, nullptr, &moved));
+  VK_CHECK(vmaBindBufferMemory(allocator, dst_allocation, moved));
+
+  VkBufferCopy copy_region = {};
+  copy_region.size = device_size;
+  vkCmdCopyBuffer(cmd, buffer, moved, 1, &copy_region);
+
+  const VkBuffer old = buffer;
+  buffer = moved;
+
+  // Update address if requested.
+  if ((usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ==
+      VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+    VkBufferDeviceAddressInfo buffer_device_address_info{};
+    buffer_device_address_info.sType =
+        VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    buffer_device_address_info.buffer = buffer;
+    address = vkGetBufferDeviceAddress(device, &buffer_device_address_info);
+  }
+
+  return old;
+}
+
 void BufferVk::destroy() {
-  vmaDestroyBuffer(allocator, buffer, allocation);
+  memory_category_bytes[uint32_t(category)] -= allocated_size();
+
+  if (defrag_release(allocation)) {
+    vkDestroyBuffer(device, buffer, nullptr);
+  } else {
+    vmaDestroyBuffer(allocator, buffer, allocation);
+  }
 
   buffer = VK_NULL_HANDLE;
   address = -1;
 
-  VmaAllocation allocation = VK_NULL_HANDLE;
-  VkDeviceSize device_size = 0;
+  allocation = VK_NULL_HANDLE;
+  device_size = 0;
 }
 
 void TextureVk::create(VkImageUsageFlags usage,
                        VkExtent3D extent,
                        VkFormat format,
-                       VkImageAspectFlags aspect) {
+                       VkImageAspectFlags aspect,
+                       uint32_t mip_levels,
+                       uint32_t array_layers,
+                       bool cube_map) {
   assert(!valid() && "Texture already initialized!");
+  assert((!cube_map || array_layers % 6 == 0) &&
+         "Cube maps require 6 layers per cube!");
+  assert((extent.depth <= 1 || array_layers == 1) &&
+         "3D textures cannot have layers!");
+  assert(mip_levels <= k_max_texture_mips && "Too many mips!");
+
+  // Assign properties.
+  this->extent = extent;
+  this->format = format;
+  this->usage = usage;
+  this->aspect = aspect;
+  this->mip_levels = std::min(mip_levels, k_max_texture_mips);
+  this->array_layers = array_layers;
+  this->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  if (extent.depth > 1) {
+    view_type = VK_IMAGE_VIEW_TYPE_3D;
+  } else if (cube_map && array_layers > 6) {
+    assert(cube_array_enabled && "Cube map arrays are not supported!");
+
+    // Faces stay addressable as layers without imageCubeArray.
+    view_type = cube_array_enabled ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY
+                                   : VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+  } else if (cube_map) {
+    view_type = VK_IMAGE_VIEW_TYPE_CUBE;
+  } else {
+    view_type = array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY
+                                 : VK_IMAGE_VIEW_TYPE_2D;
+  }
+
+  const VkImageCreateInfo img_info = image_info();
+
+  VmaAllocationCreateInfo alloc_info = {};
+  alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  alloc_info.requiredFlags =
+      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VK_CHECK(vmaCreateImage(
+      allocator, &img_info, &alloc_info, &image, &allocation, nullptr));
+
+  // Attribute memory.
+  category = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0
+                 ? MemoryCategory::k_render_target
+                 : MemoryCategory::k_texture;
+  memory_category_bytes[uint32_t(category)] += allocation->GetSize();
+
+  create_view();
+}
+
+VkImageCreateInfo TextureVk::image_info() const {
+  const bool cube_map = view_type == VK_IMAGE_VIEW_TYPE_CUBE ||
+                        view_type == VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
 
   VkImageCreateInfo img_info = {};
   img_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  img_info.flags = cube_map ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
 
   img_info.usage = usage;
   img_info.extent = extent;
   img_info.format = format;
 
-  img_info.imageType = VK_IMAGE_TYPE_2D;
+  img_info.imageType = extent.depth > 1 ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
   img_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   img_info.samples = VK_SAMPLE_COUNT_1_BIT;
   img_info.tiling = VK_IMAGE_TILING_OPTIMAL;
 
-  img_info.mipLevels = 1;
-  img_info.arrayLayers = 1;
-
-  VmaAllocationCreateInfo alloc_info = {};
-  alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-  alloc_info.requiredFlags =
-      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  img_info.mipLevels = mip_levels;
+  img_info.arrayLayers = array_layers;
 
-  VK_CHECK(vmaCreateImage(
-      allocator, &img_info, &alloc_info, &image, &allocation, nullptr));
+  return img_info;
+}
 
+void TextureVk::create_view() {
   VkImageViewCreateInfo view_info = {};
   view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.viewType = view_type;
   view_info.format = format;
   view_info.image = image;
   view_info.subresourceRange.aspectMask = aspect;
@@ -441,36 +1033,32 @@ void TextureVk::create(VkImageUsageFlags usage,
   view_info.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
 
   VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &image_view));
-
-  // Assign properties.
-  this->extent = extent;
-  this->format = format;
 }
 
 void TextureVk::update(VkCommandBuffer cmd,
-                       uint32_t offset,
-                       uint32_t size,
+                       uint32_t first_layer,
+                       uint32_t num_layers,
                        void* data) {
-  assert(offset + size <= allocation->GetSize() &&
-         "Cannot updated buffer with data. Not enough size!");
+  assert(first_layer + num_layers <= array_layers &&
+         "Cannot update texture layers out of range!");
+
+  const VkDeviceSize size = mip_chain_size(extent, format, 0, 1) * num_layers;
 
-  BufferVk& staging_buffer = transient_buffers[transient_buffer_count++];
+  BufferVk staging_buffer;
   staging_buffer.create(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, true);
-  staging_buffer.update(cmd, offset, size, data);
+  staging_buffer.update(cmd, 0, static_cast<uint32_t>(size), data);
+  retire(staging_buffer);
 
-  transition_image(cmd,
-                   image,
-                   VK_IMAGE_ASPECT_COLOR_BIT,
-                   VK_IMAGE_LAYOUT_UNDEFINED,
-                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  // Transition from the tracked layout so layers not updated are preserved.
+  transition(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
   VkBufferImageCopy image_copy = {};
   image_copy.imageExtent = extent;
   image_copy.imageOffset = {};
-  image_copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  image_copy.imageSubresource.aspectMask = aspect;
   image_copy.imageSubresource.mipLevel = 0;
-  image_copy.imageSubresource.baseArrayLayer = 0;
-  image_copy.imageSubresource.layerCount = 1;
+  image_copy.imageSubresource.baseArrayLayer = first_layer;
+  image_copy.imageSubresource.layerCount = num_layers;
 
   image_copy.bufferOffset = 0;
   image_copy.bufferRowLength = 0;
@@ -483,128 +1071,601 @@ void TextureVk::update(VkCommandBuffer cmd,
                          1,
                          &image_copy);
 
-  VkMemoryBarrier2KHR buffer_memory_barrier = {};
-  buffer_memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+  transition(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
 
-  buffer_memory_barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR;
-  buffer_memory_barrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+void TextureVk::transition(VkCommandBuffer cmd, VkImageLayout new_layout) {
+  if (layout == new_layout) {
+    return;
+  }
 
-  buffer_memory_barrier.dstStageMask =
-      VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR |
-      VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT_KHR |
-      VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR;
-  buffer_memory_barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT_KHR;
+  transition_image(cmd, image, aspect, layout, new_layout);
+  layout = new_layout;
+}
 
-  VkDependencyInfo dependency_info = {};
-  dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+void TextureVk::set_name(const char* name) {
+  vmaSetAllocationName(allocator, allocation, name);
+}
 
-  dependency_info.memoryBarrierCount = 1;
-  dependency_info.pMemoryBarriers = &buffer_memory_barrier;
+const char* TextureVk::name() const {
+  VmaAllocationInfo info = {};
+  vmaGetAllocationInfo(allocator, allocation, &info);
+  return info.pName;
+}
 
-  vkCmdPipelineBarrier2(cmd, &dependency_info);
+void TextureVk::move(VkCommandBuffer cmd,
+                     VmaAllocation dst_allocation,
+                     VkImage* old_image,
+                     VkImageView* old_view) {
+  const VkImageCreateInfo img_info = image_info();
+
+  VkImage moved = VK_NULL_HANDLE;
+  VK_CHECK(vkCreateImage(device, &img_info, nullptr, &moved));
+  VK_CHECK(vmaBindImageMemory(allocator, dst_allocation, moved));
+
+  // Images that were never written have no contents to copy.
+  if (layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+    transition_image(
+        cmd, image, aspect, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    transition_image(cmd,
+                     moved,
+                     aspect,
+                     VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkImageCopy regions[k_max_texture_mips] = {};
+    for (uint32_t mip = 0; mip < mip_levels; mip++) {
+      regions[mip].srcSubresource = {aspect, mip, 0, array_layers};
+      regions[mip].dstSubresource = {aspect, mip, 0, array_layers};
+      regions[mip].extent = mip_extent(extent, mip);
+    }
+
+    vkCmdCopyImage(cmd,
+                   image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   moved,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   mip_levels,
+                   regions);
+
+    transition_image(
+        cmd, moved, aspect, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout);
+  }
+
+  *old_image = image;
+  *old_view = image_view;
+
+  image = moved;
+  create_view();
 }
 
 void TextureVk::destroy() {
   assert(valid() && "Cannot destroy texture that has not been initialized!");
 
-  vmaDestroyImage(allocator, image, allocation);
+  memory_category_bytes[uint32_t(category)] -= allocation->GetSize();
+
+  if (defrag_release(allocation)) {
+    vkDestroyImage(device, image, nullptr);
+  } else {
+    vmaDestroyImage(allocator, image, allocation);
+  }
   vkDestroyImageView(device, image_view, nullptr);
 
   image = VK_NULL_HANDLE;
   image_view = VK_NULL_HANDLE;
+  layout = VK_IMAGE_LAYOUT_UNDEFINED;
 }
 
-void ShaderVk::create(const char* path) {
-  assert(path != nullptr && "Passed invalid path!");
+/// @returns Percentage of bytes in allocated memory blocks not in use.
+static float fragmentation_percent() {
+  VmaTotalStatistics stats = {};
+  vmaCalculateStatistics(allocator, &stats);
 
-  if (const size_t n_bytes = tsk::file_read(path, nullptr, 0)) {
-    std::vector<char> buffer(n_bytes);
-    if (tsk::file_read(path, buffer.data(), buffer.size())) {
-      VkShaderModuleCreateInfo shader_module_info = {};
-      shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-      shader_module_info.codeSize = buffer.size();
-      shader_module_info.pCode = reinterpret_cast<uint32_t*>(buffer.data());
+  const VmaStatistics& total = stats.total.statistics;
+  if (total.blockBytes == 0) {
+    return 0.0f;
+  }
 
-      assert(parse_spirv(buffer.data(),
-                         buffer.size(),
-                         bindings,
-                         &n_bindings,
-                         pc_ranges,
-                         &n_pc_ranges));
+  return 100.0f * float(total.blockBytes - total.allocationBytes) /
+         float(total.blockBytes);
+}
 
-      VK_CHECK(
-          vkCreateShaderModule(device, &shader_module_info, nullptr, &module));
-    }
-  }
+static VkBool32 VKAPI_PTR defrag_break(void* user_data) {
+  const std::chrono::duration<float, std::milli> elapsed =
+      std::chrono::steady_clock::now() - defrag_pass_start;
+  return elapsed.count() >= defrag_max_ms ? VK_TRUE : VK_FALSE;
 }
 
-void ShaderVk::destroy() {
-  n_bindings = 0;
-  n_pc_ranges = 0;
-  vkDestroyShaderModule(device, module, nullptr);
+static void finish_defragmentation() {
+  VmaDefragmentationStats stats = {};
+  vmaEndDefragmentation(allocator, defrag_context, &stats);
+  defrag_context = VK_NULL_HANDLE;
+
+  defrag_stats.bytes_moved = stats.bytesMoved;
+  defrag_stats.allocations_moved = stats.allocationsMoved;
+  defrag_stats.fragmentation_after = fragmentation_percent();
+  defrag_stats.running = false;
 }
 
-void ProgramVk::create(const ShaderVk& cs) {
-  assert(!cs.valid() && "Cannot create program with invalid compute shader!");
+/// @brief Begins a defragmentation pass and records the copies of the moved
+/// buffers and textures.
+///
+/// Moved resources are swapped in place so handles stay valid, the pass ends
+/// once the frame it was recorded in retires.
+static void record_defragmentation_pass(VkCommandBuffer cmd) {
+  defrag_pass_start = std::chrono::steady_clock::now();
+
+  if (vmaBeginDefragmentationPass(allocator, defrag_context, &defrag_pass) ==
+      VK_SUCCESS) {
+    finish_defragmentation();
+    return;
+  }
 
-  // TODO: Get descriptor layouts and bindings from shader.
-  // Allocate and define descriptor sets and bindings.
-  VkDescriptorSetLayoutBinding binding = {};
-  binding.binding = 0;
-  binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-  binding.descriptorCount = 1;
-  binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  // Make previous writes to the moved resources visible to the copies.
+  VkMemoryBarrier2 memory_barrier = {};
+  memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+  memory_barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+  memory_barrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+  memory_barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+  memory_barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
 
-  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_info = {};
-  descriptor_set_layout_info.sType =
-      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  descriptor_set_layout_info.bindingCount = 1;
-  descriptor_set_layout_info.pBindings = &binding;
+  VkDependencyInfo dependency_info = {};
+  dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+  dependency_info.memoryBarrierCount = 1;
+  dependency_info.pMemoryBarriers = &memory_barrier;
+  vkCmdPipelineBarrier2(cmd, &dependency_info);
 
-  VK_CHECK(vkCreateDescriptorSetLayout(
-      device, &descriptor_set_layout_info, nullptr, &descriptor_set_layout));
+  for (uint32_t i = 0; i < defrag_pass.moveCount; i++) {
+    VmaDefragmentationMove& move = defrag_pass.pMoves[i];
 
-  // Create pipeline layout.
-  VkPipelineLayoutCreateInfo pipeline_layout_info = {};
-  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipeline_layout_info.setLayoutCount = 1;
-  pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
+    // Host visible memory may be written by the cpu while the pass is in
+    // flight, only device local resources are moved.
+    VkMemoryPropertyFlags memory_properties = {};
+    vmaGetAllocationMemoryProperties(
+        allocator, move.srcAllocation, &memory_properties);
+    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
 
-  VK_CHECK(vkCreatePipelineLayout(
-      device, &pipeline_layout_info, nullptr, &pipeline_layout));
+    if ((memory_properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+      continue;
+    }
 
-  // Create pipeline.
-  VkPipelineShaderStageCreateInfo shader_stage_info = {};
-  shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  shader_stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-  shader_stage_info.module = cs.module;
-  shader_stage_info.pName = "main";
+    VmaAllocationInfo allocation_info = {};
+    vmaGetAllocationInfo(allocator, move.srcAllocation, &allocation_info);
+    const uintptr_t owner =
+        reinterpret_cast<uintptr_t>(allocation_info.pUserData);
+    const uint16_t handle = static_cast<uint16_t>(owner & 0xFFFF);
+
+    // Retired allocations keep the handle of a resource that may be reused.
+    if ((owner & ~uintptr_t(0xFFFF)) == k_defrag_buffer_owner) {
+      BufferVk& buffer = buffer_cache[handle];
+      if (buffer.valid() && buffer.vma_allocation() == move.srcAllocation) {
+        defrag_old_buffers.push_back(buffer.move(cmd, move.dstTmpAllocation));
+        move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY;
+        bindless_dirty(BufferHandle{handle});
+      }
+    } else if ((owner & ~uintptr_t(0xFFFF)) == k_defrag_texture_owner) {
+      TextureVk& texture = texture_cache[handle];
+      if (texture.valid() && texture.allocation == move.srcAllocation) {
+        VkImage old_image = VK_NULL_HANDLE;
+        VkImageView old_view = VK_NULL_HANDLE;
+        texture.move(cmd, move.dstTmpAllocation, &old_image, &old_view);
+
+        defrag_old_images.push_back(old_image);
+        defrag_old_image_views.push_back(old_view);
+        move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY;
+        bindless_dirty(TextureHandle{handle});
+      }
+    }
+  }
 
-  VkComputePipelineCreateInfo info{};
-  info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-  info.layout = pipeline_layout;
-  info.stage = shader_stage_info;
+  // Make the copies visible to the rest of the frame.
+  memory_barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+  memory_barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  memory_barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+  memory_barrier.dstAccessMask =
+      VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+  vkCmdPipelineBarrier2(cmd, &dependency_info);
 
-  // Create & Cache.
-  VkPipeline pipeline;
-  VK_CHECK(
-      vkCreateComputePipelines(device, nullptr, 1, &info, nullptr, &pipeline));
-  pipeline_cache[pipeline_layout] = pipeline;
+  defrag_pass_frame = current_frame;
+  defrag_stats.passes++;
 }
 
-void ProgramVk::create(const ShaderVk& vs, const ShaderVk& fs) {
-  assert(!valid() && "Program already intialized!");
-  assert(vs.valid() ||
-         fs.valid() && "Must have atleast one valid vs/fs shader!");
+/// @brief Ends the defragmentation pass recorded in the current frame context.
+///
+/// @attention The frame context must have retired.
+static void end_defragmentation_pass() {
+  if (defrag_pass_frame != current_frame) {
+    return;
+  }
 
-  n_bindings = 0;
-  VkDescriptorSetLayoutBinding bindings[k_max_program_set_bindings] = {};
+  for (VkBuffer buffer : defrag_old_buffers) {
+    vkDestroyBuffer(device, buffer, nullptr);
+  }
+  defrag_old_buffers.clear();
 
-  n_pc_ranges = 0;
-  VkPushConstantRange pc_ranges[k_max_pc_ranges] = {};
+  for (size_t i = 0; i < defrag_old_images.size(); i++) {
+    vkDestroyImageView(device, defrag_old_image_views[i], nullptr);
+    vkDestroyImage(device, defrag_old_images[i], nullptr);
+  }
+  defrag_old_images.clear();
+  defrag_old_image_views.clear();
 
-  if (vs.valid()) {
-    for (uint32_t i = 0; i < vs.n_bindings; i++) {
+  defrag_pass_frame = -1;
+  if (vmaEndDefragmentationPass(allocator, defrag_context, &defrag_pass) ==
+      VK_SUCCESS) {
+    finish_defragmentation();
+  }
+}
+
+/// @brief Uploads mips [first_mip, last_mip) of a streaming texture's data.
+///
+/// @note Leaves the texture in the transfer destination layout.
+static void upload_mips(VkCommandBuffer cmd,
+                        TextureVk& texture,
+                        const StreamingTextureVk& stream,
+                        uint8_t first_mip,
+                        uint8_t last_mip) {
+  const VkDeviceSize offset =
+      mip_chain_size(stream.extent, texture.format, 0, first_mip);
+  const VkDeviceSize size =
+      mip_chain_size(stream.extent, texture.format, first_mip, last_mip);
+
+  BufferVk staging_buffer;
+  staging_buffer.create(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, true);
+  staging_buffer.update(cmd,
+                        0,
+                        static_cast<uint32_t>(size),
+                        const_cast<uint8_t*>(stream.data + offset));
+  retire(staging_buffer);
+
+  texture.transition(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  VkBufferImageCopy regions[k_max_texture_mips] = {};
+  uint32_t n_regions = 0;
+
+  VkDeviceSize buffer_offset = 0;
+  for (uint8_t mip = first_mip; mip < last_mip; mip++) {
+    VkBufferImageCopy& region = regions[n_regions++];
+    region.bufferOffset = buffer_offset;
+    region.imageExtent = mip_extent(stream.extent, mip);
+    region.imageSubresource.aspectMask = texture.aspect;
+    region.imageSubresource.mipLevel = mip - stream.resident_mip;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+
+    buffer_offset += mip_chain_size(stream.extent, texture.format, mip, mip + 1);
+  }
+
+  vkCmdCopyBufferToImage(cmd,
+                         staging_buffer.buffer,
+                         texture.image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         n_regions,
+                         regions);
+}
+
+/// @brief Replaces the image of a streaming texture with one that holds the
+/// mips [resident_mip, num_mips).
+///
+/// Mips resident in both images are copied on the gpu, newly resident mips are
+/// uploaded from the texture data. The previous image is retired.
+static void set_resident_mip(VkCommandBuffer cmd,
+                             TextureHandle th,
+                             uint8_t resident_mip) {
+  StreamingTextureVk& stream = texture_streams[th];
+  TextureVk& current = texture_cache[th];
+
+  if (resident_mip == stream.resident_mip) {
+    return;
+  }
+
+  TextureVk next = {};
+  next.create(current.usage,
+              mip_extent(stream.extent, resident_mip),
+              current.format,
+              current.aspect,
+              stream.num_mips - resident_mip);
+  next.set_name(current.name());
+  next.transition(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  current.transition(cmd, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+  VkImageCopy regions[k_max_texture_mips] = {};
+  uint32_t n_regions = 0;
+
+  const uint8_t first_shared = std::max(resident_mip, stream.resident_mip);
+  for (uint32_t mip = first_shared; mip < stream.num_mips; mip++) {
+    VkImageCopy& region = regions[n_regions++];
+    region.srcSubresource = {current.aspect, mip - stream.resident_mip, 0, 1};
+    region.dstSubresource = {current.aspect, mip - resident_mip, 0, 1};
+    region.extent = mip_extent(stream.extent, mip);
+  }
+
+  vkCmdCopyImage(cmd,
+                 current.image,
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 next.image,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 n_regions,
+                 regions);
+
+  const uint8_t previous_mip = stream.resident_mip;
+  stream.resident_mip = resident_mip;
+
+  if (resident_mip < previous_mip) {
+    upload_mips(cmd, next, stream, resident_mip, previous_mip);
+  }
+
+  next.transition(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  texture_resident_bytes -=
+      mip_chain_size(stream.extent, next.format, previous_mip, stream.num_mips);
+  texture_resident_bytes +=
+      mip_chain_size(stream.extent, next.format, resident_mip, stream.num_mips);
+
+  retire(current);
+  current = next;
+  set_defrag_owner(current.allocation, k_defrag_texture_owner, th);
+  bindless_dirty(th);
+}
+
+/// @brief Evicts the most detailed mips of least recently used streaming
+/// textures.
+///
+/// @returns Number of bytes freed.
+static VkDeviceSize evict_textures(VkCommandBuffer cmd,
+                                   VkDeviceSize bytes,
+                                   TextureHandle keep) {
+  VkDeviceSize freed = 0;
+
+  while (freed < bytes) {
+    TextureHandle victim = TUSK_INVALID_HANDLE;
+
+    for (int i = 0; i < streaming_textures_count; i++) {
+      const TextureHandle th = streaming_textures[i];
+      const StreamingTextureVk& stream = texture_streams[th];
+
+      // Textures used this frame or at their floor cannot be evicted.
+      if (th == keep || stream.resident_mip >= stream.min_resident_mip ||
+          stream.last_used_frame >= frame_number) {
+        continue;
+      }
+
+      if (!is_valid(victim) ||
+          stream.last_used_frame < texture_streams[victim].last_used_frame) {
+        victim = th;
+      }
+    }
+
+    if (!is_valid(victim)) {
+      break;
+    }
+
+    const StreamingTextureVk& stream = texture_streams[victim];
+    const VkFormat format = texture_cache[victim].format;
+
+    uint8_t resident_mip = stream.resident_mip;
+    while (resident_mip < stream.min_resident_mip && freed < bytes) {
+      freed +=
+          mip_chain_size(stream.extent, format, resident_mip, resident_mip + 1);
+      resident_mip++;
+    }
+
+    texture_streaming_stats.evictions += resident_mip - stream.resident_mip;
+    set_resident_mip(cmd, victim, resident_mip);
+  }
+
+  return freed;
+}
+
+/// @brief Streams in the mips requested since the last frame within budget.
+static void update_texture_streaming(VkCommandBuffer cmd) {
+  texture_streaming_stats.uploads = 0;
+  texture_streaming_stats.evictions = 0;
+  texture_streaming_stats.pending_requests = 0;
+
+  int uploads = 0;
+  for (int i = 0; i < streaming_textures_count; i++) {
+    const TextureHandle th = streaming_textures[i];
+    StreamingTextureVk& stream = texture_streams[th];
+
+    const uint8_t requested_mip = stream.requested_mip;
+    stream.requested_mip = UINT8_MAX;
+
+    if (stream.data == nullptr || requested_mip >= stream.resident_mip) {
+      continue;
+    }
+
+    if (uploads >= k_max_stream_uploads) {
+      texture_streaming_stats.pending_requests++;
+      continue;
+    }
+
+    const VkFormat format = texture_cache[th].format;
+    const VkDeviceSize required = mip_chain_size(
+        stream.extent, format, requested_mip, stream.resident_mip);
+
+    if (texture_resident_bytes + required > texture_budget) {
+      evict_textures(
+          cmd, texture_resident_bytes + required - texture_budget, th);
+    }
+
+    // Stream in as many of the requested mips as fit the budget.
+    uint8_t resident_mip = requested_mip;
+    while (resident_mip < stream.resident_mip &&
+           texture_resident_bytes +
+                   mip_chain_size(stream.extent,
+                                  format,
+                                  resident_mip,
+                                  stream.resident_mip) >
+               texture_budget) {
+      resident_mip++;
+    }
+
+    if (resident_mip != requested_mip) {
+      texture_streaming_stats.pending_requests++;
+    }
+
+    if (resident_mip == stream.resident_mip) {
+      continue;
+    }
+
+    texture_streaming_stats.uploads += stream.resident_mip - resident_mip;
+    set_resident_mip(cmd, th, resident_mip);
+    uploads++;
+  }
+
+  texture_streaming_stats.resident_bytes = texture_resident_bytes;
+  texture_streaming_stats.budget_bytes = texture_budget;
+}
+
+static_assert(k_max_reflected_bindings <= k_max_program_set_bindings &&
+                  k_max_reflected_pc_ranges <= k_max_pc_ranges &&
+                  k_max_reflected_constants <= k_max_specialization_constants,
+              "Reflection records must fit shaders!");
+
+void ShaderVk::create(const void* spirv,
+                      size_t n_bytes,
+                      const ReflectionRecord& reflection) {
+  assert(spirv != nullptr && n_bytes > 0 && "Passed invalid spirv!");
+
+  VkShaderModuleCreateInfo shader_module_info = {};
+  shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  shader_module_info.codeSize = n_bytes;
+  shader_module_info.pCode = reinterpret_cast<const uint32_t*>(spirv);
+
+  n_bindings = reflection.n_bindings;
+  for (uint32_t i = 0; i < n_bindings; i++) {
+    bindings[i] = {};
+    bindings[i].binding = reflection.bindings[i].binding;
+    bindings[i].descriptorType =
+        static_cast<VkDescriptorType>(reflection.bindings[i].type);
+    bindings[i].descriptorCount = reflection.bindings[i].count;
+  }
+
+  n_pc_ranges = reflection.n_pc_ranges;
+  memcpy(pc_ranges,
+         reflection.pc_ranges,
+         n_pc_ranges * sizeof(VkPushConstantRange));
+
+  // Overridden by program variants.
+  n_constants = reflection.n_constants;
+  memcpy(constant_ids, reflection.constant_ids, n_constants * sizeof(uint32_t));
+
+  VK_CHECK(vkCreateShaderModule(device, &shader_module_info, nullptr, &module));
+}
+
+void ShaderVk::destroy() {
+  n_bindings = 0;
+  n_pc_ranges = 0;
+  n_constants = 0;
+  spirv = nullptr;
+  owned_spirv = {};
+  vkDestroyShaderModule(device, module, nullptr);
+}
+
+static void acquire_shader_module(VkShaderModule module);
+static uint32_t pack_render_state(const RenderState& state);
+static VkPipeline request_pipeline(const ProgramVk& program, uint32_t state);
+
+/// @brief Counts the descriptors of a set layout allocated from pools and
+/// adds them to the totals sizing the pools.
+static void account_pool_descriptors(
+    ProgramVk& program,
+    const VkDescriptorSetLayoutBinding* bindings,
+    uint32_t n_bindings) {
+  program.pooled = true;
+  for (uint32_t i = 0; i < n_bindings; i++) {
+    assert(bindings[i].descriptorType < k_descriptor_type_count &&
+           "[TSKGFX]: Unsupported descriptor type!");
+    program.pool_descriptors[bindings[i].descriptorType] +=
+        bindings[i].descriptorCount;
+  }
+
+  for (uint32_t t = 0; t < k_descriptor_type_count; t++) {
+    pool_descriptor_totals[t] += program.pool_descriptors[t];
+    pool_descriptor_max[t] =
+        std::max<uint32_t>(pool_descriptor_max[t], program.pool_descriptors[t]);
+  }
+  pool_programs++;
+}
+
+/// @brief Adds the specialization constants of a shader to those declared by
+/// a program.
+static void add_constant_ids(ProgramVk& program, const ShaderVk& shader) {
+  for (uint32_t i = 0; i < shader.n_constants; i++) {
+    const uint32_t* end = program.constant_ids + program.n_constant_ids;
+    if (std::find(program.constant_ids, end, shader.constant_ids[i]) != end) {
+      continue;
+    }
+
+    // Constants past the max keep the values of the shaders.
+    if (program.n_constant_ids == k_max_specialization_constants) {
+      assert(false && "[TSKGFX]: Too many specialization constants!");
+      return;
+    }
+
+    program.constant_ids[program.n_constant_ids++] = shader.constant_ids[i];
+  }
+}
+
+void ProgramVk::create(const ShaderVk& cs) {
+  assert(!cs.valid() && "Cannot create program with invalid compute shader!");
+
+  // TODO: Get descriptor layouts and bindings from shader.
+  // Allocate and define descriptor sets and bindings.
+  VkDescriptorSetLayoutBinding binding = {};
+  binding.binding = 0;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  binding.descriptorCount = 1;
+  binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_info = {};
+  descriptor_set_layout_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_info.bindingCount = 1;
+  descriptor_set_layout_info.pBindings = &binding;
+
+  VK_CHECK(vkCreateDescriptorSetLayout(
+      device, &descriptor_set_layout_info, nullptr, &descriptor_set_layout));
+  account_pool_descriptors(*this, &binding, 1);
+
+  // Bindless compute shaders read the bindless set like graphics programs,
+  // with their set moved to set 1.
+  const VkDescriptorSetLayout set_layouts[2] = {bindless_set_layout,
+                                                descriptor_set_layout};
+
+  // Create pipeline layout.
+  VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount = config.bindless ? 2 : 1;
+  pipeline_layout_info.pSetLayouts =
+      config.bindless ? set_layouts : &descriptor_set_layout;
+
+  VK_CHECK(vkCreatePipelineLayout(
+      device, &pipeline_layout_info, nullptr, &pipeline_layout));
+
+  // Compiled on the pipeline workers, see is_ready.
+  cs_module = cs.module;
+  shader_keys[0] = cs.content_key;
+  add_constant_ids(*this, cs);
+  acquire_shader_module(cs_module);
+  request_pipeline(*this, 0);
+}
+
+void ProgramVk::create(const ShaderVk& vs, const ShaderVk& fs) {
+  assert(!valid() && "Program already intialized!");
+  assert(vs.valid() ||
+         fs.valid() && "Must have atleast one valid vs/fs shader!");
+
+  n_bindings = 0;
+  VkDescriptorSetLayoutBinding bindings[k_max_program_set_bindings] = {};
+
+  n_pc_ranges = 0;
+  VkPushConstantRange pc_ranges[k_max_pc_ranges] = {};
+
+  if (vs.valid()) {
+    for (uint32_t i = 0; i < vs.n_bindings; i++) {
       bindings[vs.bindings[i].binding] = vs.bindings[i];
       bindings[vs.bindings[i].binding].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -632,19 +1693,74 @@ void ProgramVk::create(const ShaderVk& vs, const ShaderVk& fs) {
     }
   }
 
+  // Programs without bindings stay on the pooled path, which allocates no
+  // set for them, as update templates need at least one entry.
+  push_descriptors = push_descriptor_enabled && n_bindings > 0 &&
+                     n_bindings <= k_max_push_descriptor_bindings;
+
+  // Uniform buffers are bound with dynamic offsets, 0 unless in the ring.
+  // Descriptor buffers and push descriptors address the ring directly.
+  const bool dynamic_uniforms = !descriptor_buffer_enabled && !push_descriptors;
+  for (uint32_t i = 0; i < n_bindings && dynamic_uniforms; i++) {
+    if (bindings[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+      bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    }
+  }
+
+  memcpy(set_bindings,
+         bindings,
+         n_bindings * sizeof(VkDescriptorSetLayoutBinding));
+
   VkDescriptorSetLayoutCreateInfo descriptor_set_layout_info = {};
   descriptor_set_layout_info.sType =
       VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
   descriptor_set_layout_info.bindingCount = n_bindings;
   descriptor_set_layout_info.pBindings = bindings;
+  if (descriptor_buffer_enabled) {
+    descriptor_set_layout_info.flags =
+        VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+  }
+  if (push_descriptors) {
+    descriptor_set_layout_info.flags =
+        VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+  }
   VK_CHECK(vkCreateDescriptorSetLayout(
       device, &descriptor_set_layout_info, nullptr, &descriptor_set_layout));
 
+  if (!descriptor_buffer_enabled && !push_descriptors) {
+    account_pool_descriptors(*this, bindings, n_bindings);
+  }
+
+  if (descriptor_buffer_enabled) {
+    pfn_vkGetDescriptorSetLayoutSizeEXT(
+        device, descriptor_set_layout, &descriptor_buffer_size);
+
+    for (uint32_t i = 0; i < n_bindings; i++) {
+      pfn_vkGetDescriptorSetLayoutBindingOffsetEXT(
+          device, descriptor_set_layout, i, &binding_offsets[i]);
+    }
+  }
+
+  // Bindless programs share the bindless set and push constant range, so
+  // their layouts are compatible up to the bindless set.
+  const VkDescriptorSetLayout set_layouts[2] = {bindless_set_layout,
+                                                descriptor_set_layout};
+  if (config.bindless) {
+    n_pc_ranges = 1;
+    pc_ranges[0] = {};
+    pc_ranges[0].stageFlags =
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pc_ranges[0].size = sizeof(DrawPushConstants);
+  }
+  pc_stages = n_pc_ranges > 0 ? pc_ranges[0].stageFlags
+                              : VK_SHADER_STAGE_VERTEX_BIT;
+
   // Create pipeline layout.
   VkPipelineLayoutCreateInfo pipeline_layout_info = {};
   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipeline_layout_info.setLayoutCount = 1;
-  pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
+  pipeline_layout_info.setLayoutCount = config.bindless ? 2 : 1;
+  pipeline_layout_info.pSetLayouts =
+      config.bindless ? set_layouts : &descriptor_set_layout;
 
   pipeline_layout_info.pushConstantRangeCount = n_pc_ranges;
   pipeline_layout_info.pPushConstantRanges = pc_ranges;
@@ -652,36 +1768,233 @@ void ProgramVk::create(const ShaderVk& vs, const ShaderVk& fs) {
   VK_CHECK(vkCreatePipelineLayout(
       device, &pipeline_layout_info, nullptr, &pipeline_layout));
 
-  // Create pipeline.
+  // Precompute the push from the reflected bindings, binding i reads the
+  // i-th DescriptorUpdateDataVk.
+  if (push_descriptors) {
+    VkDescriptorUpdateTemplateEntry entries[k_max_push_descriptor_bindings];
+    for (uint32_t i = 0; i < n_bindings; i++) {
+      entries[i] = {};
+      entries[i].dstBinding = bindings[i].binding;
+      entries[i].descriptorCount = 1;
+      entries[i].descriptorType = bindings[i].descriptorType;
+      entries[i].offset = i * sizeof(DescriptorUpdateDataVk);
+      entries[i].stride = sizeof(DescriptorUpdateDataVk);
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo template_info = {};
+    template_info.sType =
+        VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    template_info.descriptorUpdateEntryCount = n_bindings;
+    template_info.pDescriptorUpdateEntries = entries;
+    template_info.templateType =
+        VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+    template_info.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    template_info.pipelineLayout = pipeline_layout;
+    template_info.set = config.bindless ? k_bindless_program_set : 0;
+
+    VK_CHECK(vkCreateDescriptorUpdateTemplate(
+        device, &template_info, nullptr, &update_template));
+    push_descriptor_programs++;
+  }
+
+  // The default state is compiled up front on the pipeline workers, see
+  // is_ready, other states on first use.
+  pipeline_flags = descriptor_buffer_enabled
+                       ? VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT
+                       : 0;
+  vs_module = vs.valid() ? vs.module : VK_NULL_HANDLE;
+  fs_module = fs.valid() ? fs.module : VK_NULL_HANDLE;
+  shader_keys[0] = vs.valid() ? vs.content_key : 0;
+  shader_keys[1] = fs.valid() ? fs.content_key : 0;
+  add_constant_ids(*this, vs);
+  add_constant_ids(*this, fs);
+  acquire_shader_module(vs_module);
+  acquire_shader_module(fs_module);
+  request_pipeline(*this, pack_render_state(RenderState{}));
+}
+
+void ProgramVk::destroy() {
+  if (update_template != VK_NULL_HANDLE) {
+    vkDestroyDescriptorUpdateTemplate(device, update_template, nullptr);
+  }
+
+  vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+}
+
+// Bits of a packed RenderState.
+constexpr uint32_t k_state_topology_bits = 0x7;
+constexpr uint32_t k_state_cull_bits = 0x3 << 3;
+constexpr uint32_t k_state_depth_bits = 0x1F << 5;  // Test, write and op.
+constexpr uint32_t k_state_blend_bits = 0x3 << 10;
+constexpr uint32_t k_state_library_shift = 28;  // Part of a library key.
+constexpr uint32_t k_state_library_bits = 0xFu << k_state_library_shift;
+
+/// @brief Packs a RenderState into the state bits of a PipelineKeyVk.
+static uint32_t pack_render_state(const RenderState& state) {
+  return uint32_t(state.topology) | uint32_t(state.cull_mode) << 3 |
+         uint32_t(state.depth_test) << 5 | uint32_t(state.depth_write) << 6 |
+         uint32_t(state.depth_op) << 7 | uint32_t(state.blend) << 10;
+}
+
+static RenderState unpack_render_state(uint32_t bits) {
+  RenderState state;
+  state.topology = Topology(bits & 0x7);
+  state.cull_mode = CullMode((bits >> 3) & 0x3);
+  state.depth_test = (bits >> 5) & 0x1;
+  state.depth_write = (bits >> 6) & 0x1;
+  state.depth_op = CompareOp((bits >> 7) & 0x7);
+  state.blend = BlendMode((bits >> 10) & 0x3);
+  return state;
+}
+
+/// @returns List topology of the class of a topology.
+static Topology topology_class(Topology topology) {
+  switch (topology) {
+    case Topology::k_line_strip:
+      return Topology::k_line_list;
+    case Topology::k_triangle_strip:
+      return Topology::k_triangle_list;
+    default:
+      return topology;
+  }
+}
+
+/// @returns Blend factors and ops of a blend mode.
+static VkColorBlendEquationEXT blend_equation(BlendMode blend) {
+  VkColorBlendEquationEXT equation = {};
+  equation.srcColorBlendFactor = blend == BlendMode::k_premultiplied
+                                     ? VK_BLEND_FACTOR_ONE
+                                     : VK_BLEND_FACTOR_SRC_ALPHA;
+  equation.dstColorBlendFactor = blend == BlendMode::k_additive
+                                     ? VK_BLEND_FACTOR_ONE
+                                     : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  equation.colorBlendOp = VK_BLEND_OP_ADD;
+  equation.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  equation.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  equation.alphaBlendOp = VK_BLEND_OP_ADD;
+  return equation;
+}
+
+/// @returns Key of a program's pipeline drawn with state into the final
+/// targets, compute pipelines have no state nor targets. Dynamic state bits
+/// are not part of the key.
+static PipelineKeyVk pipeline_key(const ProgramVk& program, uint32_t state) {
+  PipelineKeyVk key;
+  memset(&key, 0, sizeof(key));
+  key.layout = program.pipeline_layout;
+  key.constants = program.constants_hash;
+
+  if (program.cs_module == VK_NULL_HANDLE) {
+    key.state = state & ~dynamic_state_bits;
+
+    // A dynamic topology must be of the class the pipeline was compiled with.
+    if ((dynamic_state_bits & k_state_topology_bits) != 0 &&
+        !dynamic_topology_unrestricted) {
+      key.state |= uint32_t(
+          topology_class(Topology(state & k_state_topology_bits)));
+    }
+    key.color_format = final_color_texture.format;
+    key.depth_format = final_depth_texture.format;
+  }
+
+  return key;
+}
+
+/// @returns Pipeline of a program, VK_NULL_HANDLE while compiling.
+VkPipeline get_pipeline(const ProgramVk& program,
+                        uint32_t state = pack_render_state(RenderState{})) {
+  auto it = pipeline_cache.find(pipeline_key(program, state));
+
+  if (it == pipeline_cache.end()) {
+    return VK_NULL_HANDLE;
+  }
+
+  return it->second;
+}
+
+/// @returns Specialization of the stages of a job, reading the values in
+/// place from its constants.
+static VkSpecializationInfo specialization_info_of(
+    const PipelineJobVk& job,
+    VkSpecializationMapEntry* entries) {
+  for (uint32_t i = 0; i < job.n_constants; i++) {
+    entries[i].constantID = job.constants[i].id;
+    entries[i].offset = i * sizeof(SpecializationConstant) +
+                        offsetof(SpecializationConstant, value);
+    entries[i].size = sizeof(uint32_t);
+  }
+
+  // Ids a stage does not declare are ignored.
+  VkSpecializationInfo info = {};
+  info.mapEntryCount = job.n_constants;
+  info.pMapEntries = entries;
+  info.dataSize = job.n_constants * sizeof(SpecializationConstant);
+  info.pData = job.constants;
+  return info;
+}
+
+/// @brief Creates the compute pipeline of a job.
+static void compile_compute_pipeline(PipelineJobVk& job) {
+  VkPipelineShaderStageCreateInfo shader_stage_info = {};
+  shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shader_stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  shader_stage_info.module = job.cs;
+  shader_stage_info.pName = "main";
+
+  VkSpecializationMapEntry entries[k_max_specialization_constants];
+  VkSpecializationInfo specialization_info =
+      specialization_info_of(job, entries);
+  shader_stage_info.pSpecializationInfo = &specialization_info;
+
+  VkComputePipelineCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  info.flags = job.flags;
+  info.layout = job.key.layout;
+  info.stage = shader_stage_info;
+
+  VK_CHECK(vkCreateComputePipelines(
+      device, device_pipeline_cache, 1, &info, nullptr, &job.pipeline));
+}
+
+/// @brief Creates the graphics pipeline of a job.
+static void compile_graphics_pipeline(PipelineJobVk& job) {
+  const RenderState state = unpack_render_state(job.key.state);
+
   VkGraphicsPipelineCreateInfo info = {};
   info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  info.flags = 0;
+  info.flags = job.flags;
 
   VkPipelineShaderStageCreateInfo shader_stage_create_info[2] = {};
 
-  if (vs.valid()) {
+  VkSpecializationMapEntry entries[k_max_specialization_constants];
+  VkSpecializationInfo specialization_info =
+      specialization_info_of(job, entries);
+
+  if (job.vs != VK_NULL_HANDLE) {
     shader_stage_create_info[0].sType =
         VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shader_stage_create_info[0].flags = 0;
     shader_stage_create_info[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shader_stage_create_info[0].module = vs.module;
+    shader_stage_create_info[0].module = job.vs;
     shader_stage_create_info[0].pName = "main";
-    shader_stage_create_info[0].pSpecializationInfo = nullptr;
+    shader_stage_create_info[0].pSpecializationInfo = &specialization_info;
   }
 
-  if (fs.valid()) {
+  if (job.fs != VK_NULL_HANDLE) {
     shader_stage_create_info[1].sType =
         VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shader_stage_create_info[1].flags = 0;
     shader_stage_create_info[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shader_stage_create_info[1].module = fs.module;
+    shader_stage_create_info[1].module = job.fs;
     shader_stage_create_info[1].pName = "main";
-    shader_stage_create_info[1].pSpecializationInfo = nullptr;
+    shader_stage_create_info[1].pSpecializationInfo = &specialization_info;
   }
 
-  info.stageCount = (vs.valid() ? 1 : 0) + (fs.valid() ? 1 : 0);
-  info.pStages =
-      &shader_stage_create_info[0] + (!vs.valid() && fs.valid() ? 1 : 0);
+  const bool has_vs = job.vs != VK_NULL_HANDLE;
+  const bool has_fs = job.fs != VK_NULL_HANDLE;
+  info.stageCount = (has_vs ? 1 : 0) + (has_fs ? 1 : 0);
+  info.pStages = &shader_stage_create_info[0] + (!has_vs && has_fs ? 1 : 0);
 
   VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info = {};
   vertex_input_state_create_info.sType =
@@ -692,7 +2005,7 @@ void ProgramVk::create(const ShaderVk& vs, const ShaderVk& fs) {
   input_assembly_state_create_info.sType =
       VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
   input_assembly_state_create_info.topology =
-      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+      VkPrimitiveTopology(state.topology);
   input_assembly_state_create_info.primitiveRestartEnable = VK_FALSE;
   info.pInputAssemblyState = &input_assembly_state_create_info;
 
@@ -716,7 +2029,7 @@ void ProgramVk::create(const ShaderVk& vs, const ShaderVk& fs) {
   rasterization_state_create_info.depthClampEnable = VK_FALSE;
   rasterization_state_create_info.rasterizerDiscardEnable = VK_FALSE;
   rasterization_state_create_info.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterization_state_create_info.cullMode = VK_CULL_MODE_NONE;
+  rasterization_state_create_info.cullMode = VkCullModeFlags(state.cull_mode);
   rasterization_state_create_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
   rasterization_state_create_info.depthBiasEnable = VK_FALSE;
   rasterization_state_create_info.depthBiasConstantFactor = 1.0f;
@@ -742,12 +2055,9 @@ void ProgramVk::create(const ShaderVk& vs, const ShaderVk& fs) {
   VkPipelineDepthStencilStateCreateInfo depth_stencil_state_create_info = {};
   depth_stencil_state_create_info.sType =
       VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depth_stencil_state_create_info.depthTestEnable = VK_TRUE;
-  depth_stencil_state_create_info.depthWriteEnable = VK_TRUE;
-
-  // Inverted depth for accuracy.
-  depth_stencil_state_create_info.depthCompareOp =
-      VK_COMPARE_OP_GREATER_OR_EQUAL;
+  depth_stencil_state_create_info.depthTestEnable = state.depth_test;
+  depth_stencil_state_create_info.depthWriteEnable = state.depth_write;
+  depth_stencil_state_create_info.depthCompareOp = VkCompareOp(state.depth_op);
 
   depth_stencil_state_create_info.depthBoundsTestEnable = VK_FALSE;
   depth_stencil_state_create_info.stencilTestEnable = VK_FALSE;
@@ -767,34 +2077,58 @@ void ProgramVk::create(const ShaderVk& vs, const ShaderVk& fs) {
   color_blend_state_create_info.logicOp = VK_LOGIC_OP_COPY;
   color_blend_state_create_info.attachmentCount = 1;
 
+  const VkColorBlendEquationEXT equation = blend_equation(state.blend);
   VkPipelineColorBlendAttachmentState color_blend_attachment_state = {};
-  color_blend_attachment_state.blendEnable = VK_TRUE;
+  color_blend_attachment_state.blendEnable = state.blend != BlendMode::k_opaque;
   color_blend_attachment_state.colorWriteMask =
       VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
       VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  color_blend_attachment_state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  color_blend_attachment_state.srcColorBlendFactor =
+      equation.srcColorBlendFactor;
   color_blend_attachment_state.dstColorBlendFactor =
-      VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-  color_blend_attachment_state.colorBlendOp = VK_BLEND_OP_ADD;
-  color_blend_attachment_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-  color_blend_attachment_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-  color_blend_attachment_state.alphaBlendOp = VK_BLEND_OP_ADD;
+      equation.dstColorBlendFactor;
+  color_blend_attachment_state.colorBlendOp = equation.colorBlendOp;
+  color_blend_attachment_state.srcAlphaBlendFactor =
+      equation.srcAlphaBlendFactor;
+  color_blend_attachment_state.dstAlphaBlendFactor =
+      equation.dstAlphaBlendFactor;
+  color_blend_attachment_state.alphaBlendOp = equation.alphaBlendOp;
 
   color_blend_state_create_info.pAttachments = &color_blend_attachment_state;
 
   info.pColorBlendState = &color_blend_state_create_info;
 
-  VkDynamicState dynamic_state[2] = {VK_DYNAMIC_STATE_VIEWPORT,
-                                     VK_DYNAMIC_STATE_SCISSOR};
+  // The state above is ignored where dynamic, see set_dynamic_state.
+  VkDynamicState dynamic_state[10] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                      VK_DYNAMIC_STATE_SCISSOR};
+  uint32_t dynamic_state_count = 2;
+  if (dynamic_state_bits & k_state_topology_bits) {
+    dynamic_state[dynamic_state_count++] = VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY;
+  }
+  if (dynamic_state_bits & k_state_cull_bits) {
+    dynamic_state[dynamic_state_count++] = VK_DYNAMIC_STATE_CULL_MODE;
+  }
+  if (dynamic_state_bits & k_state_depth_bits) {
+    dynamic_state[dynamic_state_count++] = VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE;
+    dynamic_state[dynamic_state_count++] = VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE;
+    dynamic_state[dynamic_state_count++] = VK_DYNAMIC_STATE_DEPTH_COMPARE_OP;
+  }
+  if (dynamic_state_bits & k_state_blend_bits) {
+    dynamic_state[dynamic_state_count++] =
+        VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT;
+    dynamic_state[dynamic_state_count++] =
+        VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT;
+  }
+
   VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {};
   dynamic_state_create_info.sType =
       VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
   dynamic_state_create_info.pDynamicStates = dynamic_state;
-  dynamic_state_create_info.dynamicStateCount = 2;
+  dynamic_state_create_info.dynamicStateCount = dynamic_state_count;
 
   info.pDynamicState = &dynamic_state_create_info;
 
-  info.layout = pipeline_layout;
+  info.layout = job.key.layout;
 
   info.renderPass = VK_NULL_HANDLE;
   info.basePipelineHandle = VK_NULL_HANDLE;
@@ -802,35 +2136,799 @@ void ProgramVk::create(const ShaderVk& vs, const ShaderVk& fs) {
   VkPipelineRenderingCreateInfo render_info = {};
   render_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
 
-  VkFormat color_attachment_format = final_color_texture.format;
+  VkFormat color_attachment_format = job.key.color_format;
   render_info.colorAttachmentCount = 1;
   render_info.pColorAttachmentFormats = &color_attachment_format;
 
-  VkFormat depth_attachment_format = VK_FORMAT_D32_SFLOAT;
+  VkFormat depth_attachment_format = job.key.depth_format;
   render_info.depthAttachmentFormat = depth_attachment_format;
 
   info.pNext = &render_info;
 
-  // Create & Cache.
-  VkPipeline pipeline = VK_NULL_HANDLE;
-  VK_CHECK(
-      vkCreateGraphicsPipelines(device, nullptr, 1, &info, nullptr, &pipeline));
-  pipeline_cache[pipeline_layout] = pipeline;
+  // Only the state of the library's part is read.
+  VkGraphicsPipelineLibraryCreateInfoEXT library_info = {};
+  if (job.library != 0) {
+    library_info.sType =
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+    library_info.flags = job.library;
+    render_info.pNext = &library_info;
+  }
+
+  // Create.
+  VK_CHECK(vkCreateGraphicsPipelines(
+      device, device_pipeline_cache, 1, &info, nullptr, &job.pipeline));
 }
 
-void ProgramVk::destroy() {
-  vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
-  vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+/// @brief Links the graphics pipeline of a job from its libraries.
+static void link_graphics_pipeline(PipelineJobVk& job) {
+  VkPipelineLibraryCreateInfoKHR library_info = {};
+  library_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+  library_info.libraryCount = job.n_libraries;
+  library_info.pLibraries = job.libraries;
+
+  VkGraphicsPipelineCreateInfo info = {};
+  info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  info.pNext = &library_info;
+  info.flags = job.flags;
+  info.layout = job.key.layout;
+
+  VK_CHECK(vkCreateGraphicsPipelines(
+      device, device_pipeline_cache, 1, &info, nullptr, &job.pipeline));
 }
 
-VkPipeline get_pipeline(const ProgramVk& program) {
-  auto it = pipeline_cache.find(program.pipeline_layout);
+/// @brief Runs on a pipeline worker, the job is handed back to the render
+/// thread by collect_pipelines.
+static void compile_pipeline(PipelineJobVk* job) {
+  const auto start = std::chrono::steady_clock::now();
+
+  if (job->cs != VK_NULL_HANDLE) {
+    compile_compute_pipeline(*job);
+  } else if (job->n_libraries > 0) {
+    link_graphics_pipeline(*job);
+  } else {
+    compile_graphics_pipeline(*job);
+  }
+
+  const std::chrono::duration<float, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  job->create_ms = elapsed.count();
+
+  std::lock_guard<std::mutex> lock(compiled_pipelines_mutex);
+  compiled_pipelines.push_back(job);
+}
+
+static void acquire_shader_module(VkShaderModule module) {
+  if (module != VK_NULL_HANDLE) {
+    shader_module_refs[module]++;
+  }
+}
+
+/// @brief Destroys a module released by its last reference if its shader was
+/// destroyed.
+static void release_shader_module(VkShaderModule module) {
+  if (module == VK_NULL_HANDLE || --shader_module_refs[module] > 0) {
+    return;
+  }
+  shader_module_refs.erase(module);
+
+  auto it = std::find(
+      retired_shader_modules.begin(), retired_shader_modules.end(), module);
+  if (it != retired_shader_modules.end()) {
+    vkDestroyShaderModule(device, module, nullptr);
+    retired_shader_modules.erase(it);
+  }
+}
+
+/// @returns Job compiling the pipeline of a program with key.
+static PipelineJobVk* create_pipeline_job(const ProgramVk& program,
+                                          const PipelineKeyVk& key) {
+  PipelineJobVk* job = new PipelineJobVk();
+  job->key = key;
+  job->flags = program.pipeline_flags;
+  job->vs = program.vs_module;
+  job->fs = program.fs_module;
+  job->cs = program.cs_module;
+  job->n_constants = program.n_constants;
+  memcpy(job->constants,
+         program.constants,
+         program.n_constants * sizeof(SpecializationConstant));
+  return job;
+}
+
+/// @brief Queues a job on the pipeline workers, it keeps the shader modules
+/// and pipeline layout alive until collected.
+static void schedule_pipeline_job(PipelineJobVk* job) {
+  for (VkShaderModule module : {job->vs, job->fs, job->cs}) {
+    acquire_shader_module(module);
+  }
+
+  pending_pipelines[job->key] = job;
+  pipeline_workers.submit([job]() { compile_pipeline(job); });
+}
+
+constexpr VkGraphicsPipelineLibraryFlagBitsEXT k_pipeline_library_parts[4] = {
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT};
+
+/// @returns Key of the library of a pipeline part, holding only the state and
+/// targets the part reads. Vertex input and fragment output libraries have no
+/// shaders and are shared by programs.
+static PipelineKeyVk library_key(const PipelineKeyVk& key,
+                                 VkGraphicsPipelineLibraryFlagBitsEXT part) {
+  PipelineKeyVk library = key;
+
+  switch (part) {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+      library.layout = VK_NULL_HANDLE;
+      library.constants = 0;
+      library.state &= k_state_topology_bits;
+      library.color_format = VK_FORMAT_UNDEFINED;
+      library.depth_format = VK_FORMAT_UNDEFINED;
+      break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+      library.state &= k_state_cull_bits;
+      library.color_format = VK_FORMAT_UNDEFINED;
+      library.depth_format = VK_FORMAT_UNDEFINED;
+      break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+      library.state &= k_state_depth_bits;
+      break;
+    default:
+      library.layout = VK_NULL_HANDLE;
+      library.constants = 0;
+      library.state &= k_state_blend_bits;
+      break;
+  }
+
+  library.state |= uint32_t(part) << k_state_library_shift;
+  return library;
+}
+
+/// @returns Pipeline fast linked from the libraries of its parts,
+/// VK_NULL_HANDLE while a library compiles. An optimized link is queued to
+/// replace it.
+static VkPipeline link_pipeline(const ProgramVk& program,
+                                const PipelineKeyVk& key) {
+  VkPipeline libraries[4] = {};
+  bool compiling = false;
+
+  for (uint32_t i = 0; i < 4; i++) {
+    const VkGraphicsPipelineLibraryFlagBitsEXT part =
+        k_pipeline_library_parts[i];
+    const PipelineKeyVk library = library_key(key, part);
+
+    auto it = pipeline_cache.find(library);
+    if (it != pipeline_cache.end()) {
+      libraries[i] = it->second;
+      continue;
+    }
+
+    compiling = true;
+    if (pending_pipelines.count(library) > 0) {
+      continue;
+    }
+
+    // Libraries compile the stage of their part only.
+    PipelineJobVk* job = create_pipeline_job(program, library);
+    job->library = part;
+    job->flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+                  VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+    if (part !=
+        VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) {
+      job->vs = VK_NULL_HANDLE;
+    }
+    if (part != VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) {
+      job->fs = VK_NULL_HANDLE;
+    }
+    schedule_pipeline_job(job);
+  }
+
+  if (compiling) {
+    return VK_NULL_HANDLE;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+
+  PipelineJobVk link;
+  link.key = key;
+  link.flags = program.pipeline_flags;
+  memcpy(link.libraries, libraries, sizeof(libraries));
+  link.n_libraries = 4;
+  link_graphics_pipeline(link);
+
+  const std::chrono::duration<float, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  pipeline_cache_stats.link_ms += elapsed.count();
+  pipeline_cache_stats.pipelines_linked++;
+
+  pipeline_cache[key] = link.pipeline;
+
+  PipelineJobVk* job = create_pipeline_job(program, key);
+  job->flags |= VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+  job->vs = VK_NULL_HANDLE;
+  job->fs = VK_NULL_HANDLE;
+  memcpy(job->libraries, libraries, sizeof(libraries));
+  job->n_libraries = 4;
+  schedule_pipeline_job(job);
+
+  return link.pipeline;
+}
+
+/// @returns Pipeline of a program drawn with state, VK_NULL_HANDLE while it
+/// compiles. Compilation is queued on the pipeline workers on first request.
+static VkPipeline request_pipeline(const ProgramVk& program, uint32_t state) {
+  const PipelineKeyVk key = pipeline_key(program, state);
+
+  auto it = pipeline_cache.find(key);
+  if (it != pipeline_cache.end()) {
+    return it->second;
+  }
+
+  if (pending_pipelines.count(key) > 0) {
+    return VK_NULL_HANDLE;
+  }
+
+  if (pipeline_library_enabled && program.cs_module == VK_NULL_HANDLE) {
+    return link_pipeline(program, key);
+  }
+
+  schedule_pipeline_job(create_pipeline_job(program, key));
+  return VK_NULL_HANDLE;
+}
+
+/// @returns 'true' if a job of a pipeline layout is pending.
+static bool compiling_layout(VkPipelineLayout layout) {
+  return std::any_of(pending_pipelines.begin(),
+                     pending_pipelines.end(),
+                     [layout](const auto& pending) {
+                       return pending.first.layout == layout;
+                     });
+}
+
+/// @brief Retires a pipeline of a destroyed program. Libraries linked by
+/// pending jobs are kept until collect_pipelines.
+static void retire_pipeline(const PipelineKeyVk& key,
+                            VkPipeline pipeline,
+                            bool compiling) {
+  if (compiling && (key.state & k_state_library_bits) != 0) {
+    retired_pipeline_libraries.emplace_back(key.layout, pipeline);
+  } else {
+    deletion_queue().pipelines.push_back(pipeline);
+  }
+}
+
+/// @brief Caches the pipelines compiled since the last call and releases what
+/// their jobs kept alive.
+static void collect_pipelines() {
+  std::vector<PipelineJobVk*> jobs;
+  {
+    std::lock_guard<std::mutex> lock(compiled_pipelines_mutex);
+    jobs.swap(compiled_pipelines);
+  }
+
+  for (PipelineJobVk* job : jobs) {
+    pending_pipelines.erase(job->key);
+
+    for (VkShaderModule module : {job->vs, job->fs, job->cs}) {
+      release_shader_module(module);
+    }
+
+    pipeline_cache_stats.create_ms += job->create_ms;
+    pipeline_cache_stats.pipelines_created++;
+
+    if (!job->cancelled) {
+      // Optimized links replace the fast linked pipeline.
+      auto linked = pipeline_cache.find(job->key);
+      if (linked != pipeline_cache.end()) {
+        deletion_queue().pipelines.push_back(linked->second);
+      }
+
+      pipeline_cache[job->key] = job->pipeline;
+      delete job;
+      continue;
+    }
+
+    // The layout is retired with the last pipeline of the destroyed program,
+    // destroyed variants leave it to their program.
+    DeletionQueueVk& queue = deletion_queue();
+    queue.pipelines.push_back(job->pipeline);
+
+    auto retired = std::find(retired_pipeline_layouts.begin(),
+                             retired_pipeline_layouts.end(),
+                             job->key.layout);
+    if (retired != retired_pipeline_layouts.end() &&
+        !compiling_layout(job->key.layout)) {
+      queue.pipeline_layouts.push_back(job->key.layout);
+      retired_pipeline_layouts.erase(retired);
+    }
+
+    delete job;
+  }
+
+  for (auto it = retired_pipeline_libraries.begin();
+       it != retired_pipeline_libraries.end();) {
+    if (compiling_layout(it->first)) {
+      ++it;
+      continue;
+    }
+
+    deletion_queue().pipelines.push_back(it->second);
+    it = retired_pipeline_libraries.erase(it);
+  }
+}
+
+/// @returns Usage of a program's pipeline drawn with state into the final
+/// targets.
+static PsoUsageVk pso_usage_of(const ProgramVk& program, uint32_t state) {
+  PsoUsageVk usage;
+  memset(&usage, 0, sizeof(usage));
+  memcpy(usage.shader_keys, program.shader_keys, sizeof(usage.shader_keys));
+  usage.constants = program.constants_hash;
+  usage.state = state;
+  usage.color_format = final_color_texture.format;
+  usage.depth_format = final_depth_texture.format;
+  return usage;
+}
+
+/// @brief Sets the time to warm once every requested pipeline is ready.
+static void finish_warmup() {
+  if (!warming_pipelines.empty()) {
+    return;
+  }
+
+  const std::chrono::duration<float, std::milli> elapsed =
+      std::chrono::steady_clock::now() - warmup_start;
+  pipeline_cache_stats.warmup_ms = elapsed.count();
+}
+
+/// @brief Requests the pipelines the last run drew with a program, so they
+/// compile before its first draw.
+static void request_recorded_pipelines(ProgramHandle ph) {
+  const ProgramVk& program = program_cache[ph];
+
+  // States differing in dynamic bits share a pipeline, counted once.
+  std::vector<PipelineKeyVk> requested;
+  for (const PsoUsageVk& usage : recorded_pso_usage) {
+    // Usages of other programs or targets are skipped.
+    if (!(usage == pso_usage_of(program, usage.state))) {
+      continue;
+    }
+
+    const PipelineKeyVk key = pipeline_key(program, usage.state);
+    if (std::find(requested.begin(), requested.end(), key) !=
+        requested.end()) {
+      continue;
+    }
+    requested.push_back(key);
+
+    // Pipelines already cached count as compiled.
+    pipeline_cache_stats.warmup_requested++;
+    if (request_pipeline(program, usage.state) != VK_NULL_HANDLE) {
+      pipeline_cache_stats.warmup_compiled++;
+      continue;
+    }
+
+    warming_pipelines.emplace_back(ph, usage.state);
+  }
+
+  if (!requested.empty()) {
+    finish_warmup();
+  }
+}
+
+/// @brief Polls the requested recorded pipelines, linking those whose
+/// libraries compiled.
+static void warm_up_pipelines() {
+  if (warming_pipelines.empty()) {
+    return;
+  }
+
+  const auto ready =
+      std::remove_if(warming_pipelines.begin(),
+                     warming_pipelines.end(),
+                     [](const std::pair<ProgramHandle, uint32_t>& warming) {
+                       return request_pipeline(program_cache[warming.first],
+                                               warming.second) !=
+                              VK_NULL_HANDLE;
+                     });
+  pipeline_cache_stats.warmup_compiled +=
+      static_cast<uint32_t>(warming_pipelines.end() - ready);
+  warming_pipelines.erase(ready, warming_pipelines.end());
+
+  finish_warmup();
+}
+
+/// @brief Drops the recorded pipelines of destroyed programs from the
+/// warm-up.
+static void cancel_warmup() {
+  const auto destroyed =
+      std::remove_if(warming_pipelines.begin(),
+                     warming_pipelines.end(),
+                     [](const std::pair<ProgramHandle, uint32_t>& warming) {
+                       return !program_cache[warming.first].valid();
+                     });
+  if (destroyed == warming_pipelines.end()) {
+    return;
+  }
+
+  pipeline_cache_stats.warmup_requested -=
+      static_cast<uint32_t>(warming_pipelines.end() - destroyed);
+  warming_pipelines.erase(destroyed, warming_pipelines.end());
+  finish_warmup();
+}
+
+/// @returns `true` if the sets of both programs are defined identically, so
+/// descriptors bound for one can be bound to the other.
+static bool same_set_layout(const ProgramVk& a, const ProgramVk& b) {
+  if (a.descriptor_set_layout == b.descriptor_set_layout) {
+    return true;
+  }
+
+  if (a.n_bindings != b.n_bindings ||
+      a.push_descriptors != b.push_descriptors) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < a.n_bindings; i++) {
+    const VkDescriptorSetLayoutBinding& binding_a = a.set_bindings[i];
+    const VkDescriptorSetLayoutBinding& binding_b = b.set_bindings[i];
+    if (binding_a.binding != binding_b.binding ||
+        binding_a.descriptorType != binding_b.descriptorType ||
+        binding_a.descriptorCount != binding_b.descriptorCount ||
+        binding_a.stageFlags != binding_b.stageFlags) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// @brief Resolves the pipeline of each draw into draw_pipelines. Draws of
+/// pipelines still compiling are removed from the frame, or drawn with the
+/// default state of the fallback program if it is ready and its set matches.
+static void resolve_pending_draws(Frame* frame) {
+  const VkPipeline fallback =
+      is_valid(fallback_ph)
+          ? request_pipeline(program_cache[fallback_ph],
+                             pack_render_state(RenderState{}))
+          : VK_NULL_HANDLE;
+
+  uint32_t draw_count = 0;
+  for (uint32_t i = 0; i < frame->draw_count; i++) {
+    RenderDraw& draw = frame->draws[i];
+
+    const ProgramVk& program = program_cache[draw.ph];
+    const uint32_t state = pack_render_state(draw.state);
+    VkPipeline pipeline = request_pipeline(program, state);
+    if (pipeline != VK_NULL_HANDLE && !pso_usage_path.empty()) {
+      pso_usage.insert(pso_usage_of(program, state));
+    }
+
+    if (pipeline == VK_NULL_HANDLE) {
+      if (fallback == VK_NULL_HANDLE) {
+        continue;
+      }
+
+      // The fallback is drawn with the draw's bindings, or none, and its
+      // default state. Draws binding a different set are skipped.
+      const ProgramVk& fallback_program = program_cache[fallback_ph];
+      if (fallback_program.n_bindings > 0 &&
+          !same_set_layout(program, fallback_program)) {
+        continue;
+      }
+
+      pipeline = fallback;
+      draw.ph = fallback_ph;
+      draw.state = RenderState{};
+      if (fallback_program.n_bindings == 0) {
+        draw.dh_count = 0;
+      }
+    }
+
+    if (draw_count != i) {
+      frame->draws[draw_count] = draw;
+    }
+    draw_pipelines[draw_count] = pipeline;
+    draw_count++;
+  }
+
+  // Slots past the kept draws are reused by the next frame.
+  for (uint32_t i = draw_count; i < frame->draw_count; i++) {
+    frame->draws[i].clear();
+  }
+  frame->draw_count = draw_count;
+}
+
+/// @brief Sets the dynamic state of a draw, changed are the packed state bits
+/// that differ from the last draw.
+static void set_dynamic_state(VkCommandBuffer cmd,
+                              const RenderState& state,
+                              uint32_t changed) {
+  changed &= dynamic_state_bits;
+
+  if (changed & k_state_topology_bits) {
+    vkCmdSetPrimitiveTopology(cmd, VkPrimitiveTopology(state.topology));
+  }
+
+  if (changed & k_state_cull_bits) {
+    vkCmdSetCullMode(cmd, VkCullModeFlags(state.cull_mode));
+  }
+
+  if (changed & k_state_depth_bits) {
+    vkCmdSetDepthTestEnable(cmd, state.depth_test);
+    vkCmdSetDepthWriteEnable(cmd, state.depth_write);
+    vkCmdSetDepthCompareOp(cmd, VkCompareOp(state.depth_op));
+  }
+
+  if (changed & k_state_blend_bits) {
+    const VkBool32 blend_enable = state.blend != BlendMode::k_opaque;
+    const VkColorBlendEquationEXT equation = blend_equation(state.blend);
+    pfn_vkCmdSetColorBlendEnableEXT(cmd, 0, 1, &blend_enable);
+    pfn_vkCmdSetColorBlendEquationEXT(cmd, 0, 1, &equation);
+  }
+}
+
+/// @brief Creates the pipeline cache, seeded from pipeline_cache_path if the
+/// file was written by the same device and driver.
+static void create_pipeline_cache() {
+  VkPhysicalDeviceIDProperties id_properties = {};
+  id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 properties = {};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &id_properties;
+  vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+  PipelineCacheHeaderVk& header = pipeline_cache_header;
+  header = {};
+  header.magic = k_pipeline_cache_magic;
+  header.version = k_pipeline_cache_version;
+  header.vendor_id = properties.properties.vendorID;
+  header.device_id = properties.properties.deviceID;
+  header.driver_version = properties.properties.driverVersion;
+  memcpy(header.pipeline_cache_uuid,
+         properties.properties.pipelineCacheUUID,
+         VK_UUID_SIZE);
+  memcpy(header.driver_uuid, id_properties.driverUUID, VK_UUID_SIZE);
+
+  std::vector<char> buffer;
+  const char* data = nullptr;
+  size_t data_size = 0;
+
+  const char* path = pipeline_cache_path.c_str();
+  if (const size_t n_bytes =
+          pipeline_cache_path.empty() ? 0 : tsk::file_read(path, nullptr, 0)) {
+    buffer.resize(n_bytes);
+
+    // Stale or corrupt files are ignored and replaced on save.
+    PipelineCacheHeaderVk file_header = {};
+    if (n_bytes > sizeof(file_header) &&
+        tsk::file_read(path, buffer.data(), buffer.size())) {
+      memcpy(&file_header, buffer.data(), sizeof(file_header));
+
+      uint32_t hash = 0;
+      const char* file_data = buffer.data() + sizeof(file_header);
+      const size_t file_data_size = n_bytes - sizeof(file_header);
+      tsk::murmur_hash3_x86_32(file_data, file_data_size, 0, &hash);
+
+      PipelineCacheHeaderVk expected = header;
+      expected.data_size = file_data_size;
+      expected.data_hash = hash;
+      if (memcmp(&file_header, &expected, sizeof(expected)) == 0) {
+        data = file_data;
+        data_size = file_data_size;
+      }
+    }
+  }
+
+  VkPipelineCacheCreateInfo cache_info = {};
+  cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cache_info.initialDataSize = data_size;
+  cache_info.pInitialData = data;
+  VK_CHECK(vkCreatePipelineCache(
+      device, &cache_info, nullptr, &device_pipeline_cache));
+
+  pipeline_cache_stats.warm = data != nullptr;
+  pipeline_cache_stats.loaded_bytes = data_size;
+}
+
+/// @brief Loads the pipelines recorded by the last run from pso_usage_path.
+static void load_pso_usage() {
+  const char* path = pso_usage_path.c_str();
+  const size_t n_bytes =
+      pso_usage_path.empty() ? 0 : tsk::file_read(path, nullptr, 0);
+  if (n_bytes < sizeof(PsoUsageHeaderVk)) {
+    return;
+  }
+
+  std::vector<char> buffer(n_bytes);
+  if (!tsk::file_read(path, buffer.data(), buffer.size())) {
+    return;
+  }
+
+  // Stale or truncated files are ignored and replaced at shutdown.
+  PsoUsageHeaderVk header = {};
+  memcpy(&header, buffer.data(), sizeof(header));
+  const size_t records_size = n_bytes - sizeof(header);
+  if (header.magic != k_pso_usage_magic ||
+      header.version != k_pso_usage_version ||
+      records_size != uint64_t(header.n_records) * sizeof(PsoUsageVk)) {
+    return;
+  }
+
+  recorded_pso_usage.resize(header.n_records);
+  memcpy(recorded_pso_usage.data(),
+         buffer.data() + sizeof(header),
+         records_size);
+  pipeline_cache_stats.warmup_recorded = header.n_records;
+}
+
+/// @brief Records the pipelines drawn this run to pso_usage_path, runs that
+/// drew nothing keep the last record.
+static void save_pso_usage() {
+  if (pso_usage_path.empty() || pso_usage.empty()) {
+    return;
+  }
+
+  PsoUsageHeaderVk header = {};
+  header.magic = k_pso_usage_magic;
+  header.version = k_pso_usage_version;
+  header.n_records = static_cast<uint32_t>(pso_usage.size());
+
+  const std::vector<PsoUsageVk> records(pso_usage.begin(), pso_usage.end());
+
+  // Renamed over the last record like the pipeline cache.
+  const std::string temp_path = pso_usage_path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    return;
+  }
+
+  const bool written =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(records.data(), sizeof(PsoUsageVk), records.size(), file) ==
+          records.size() &&
+      fflush(file) == 0;
+  fclose(file);
+
+  std::error_code error;
+  if (written) {
+    std::filesystem::rename(temp_path, pso_usage_path, error);
+  }
+
+  if (!written || error) {
+    std::filesystem::remove(temp_path, error);
+  }
+}
+
+/// @brief Creates a descriptor pool and appends it to the chain.
+///
+/// Pools double in sets from k_min_descriptor_sets up to
+/// k_max_descriptor_sets. Each type is sized for the average descriptors per
+/// set of the created programs with headroom, and at least for the largest
+/// set so any set fits a new pool.
+static VkDescriptorPool create_descriptor_pool() {
+  const uint32_t growth = std::min<uint32_t>(
+      static_cast<uint32_t>(descriptor_pools.size()), 8);
+  const uint32_t max_sets = std::min<uint32_t>(k_min_descriptor_sets << growth,
+                                               k_max_descriptor_sets);
+
+  VkDescriptorPoolSize pool_sizes[k_descriptor_type_count] = {};
+  uint32_t pool_size_count = 0;
+
+  for (uint32_t t = 0; t < k_descriptor_type_count; t++) {
+    if (pool_descriptor_max[t] == 0) {
+      continue;
+    }
+
+    const float average =
+        float(pool_descriptor_totals[t]) / float(std::max(pool_programs, 1u));
+    const uint32_t count = static_cast<uint32_t>(
+        std::ceil(average * float(max_sets) * k_descriptor_pool_headroom));
+
+    pool_sizes[pool_size_count++] = {
+        VkDescriptorType(t), std::max(count, pool_descriptor_max[t])};
+  }
+
+  // No program yet, reserve the types programs commonly bind.
+  if (pool_size_count == 0) {
+    const VkDescriptorType types[] = {
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+    };
+
+    for (VkDescriptorType type : types) {
+      pool_sizes[pool_size_count++] = {type, max_sets};
+    }
+  }
+
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  pool_info.maxSets = max_sets;
+  pool_info.poolSizeCount = pool_size_count;
+  pool_info.pPoolSizes = pool_sizes;
+
+  VkDescriptorPool pool;
+  VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &pool));
+
+  descriptor_pools.push_back(pool);
+  return pool;
+}
+
+/// @brief Allocates a set from the first pool of the chain with room, growing
+/// the chain once all pools are exhausted.
+static DescriptorSetAllocationVk allocate_descriptor_set(
+    VkDescriptorSetLayout layout) {
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &layout;
+
+  DescriptorSetAllocationVk allocation = {};
+  for (VkDescriptorPool pool : descriptor_pools) {
+    alloc_info.descriptorPool = pool;
+
+    const VkResult result =
+        vkAllocateDescriptorSets(device, &alloc_info, &allocation.set);
+    if (result == VK_SUCCESS) {
+      allocation.pool = pool;
+      return allocation;
+    }
+
+    if (result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+        result != VK_ERROR_FRAGMENTED_POOL) {
+      VK_CHECK(result);
+    }
+  }
+
+  allocation.pool = create_descriptor_pool();
+  alloc_info.descriptorPool = allocation.pool;
+  VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &allocation.set));
+
+  return allocation;
+}
+
+/// @brief Evicts cached descriptor sets unused for k_descriptor_set_max_age
+/// frames, then the least recently used sets over the cache bound.
+static void evict_descriptor_sets() {
+  for (auto it = ds_set_cache.begin(); it != ds_set_cache.end();) {
+    if (frame_number - it->second.last_used_frame <= k_descriptor_set_max_age) {
+      ++it;
+      continue;
+    }
+
+    retire(it->second.allocation);
+    it = ds_set_cache.erase(it);
+    descriptor_cache_stats.evictions++;
+  }
+
+  if (ds_set_cache.size() <= k_max_cached_descriptor_sets) {
+    return;
+  }
 
-  if (it == pipeline_cache.end()) {
-    return VK_NULL_HANDLE;
+  std::vector<std::pair<uint64_t, DescriptorSetKeyVk>> lru;
+  lru.reserve(ds_set_cache.size());
+  for (const auto& [key, cached] : ds_set_cache) {
+    lru.emplace_back(cached.last_used_frame, key);
   }
 
-  return it->second;
+  const size_t excess = ds_set_cache.size() - k_max_cached_descriptor_sets;
+  std::nth_element(
+      lru.begin(), lru.begin() + excess, lru.end(), [](auto& a, auto& b) {
+        return a.first < b.first;
+      });
+
+  for (size_t i = 0; i < excess; i++) {
+    auto it = ds_set_cache.find(lru[i].second);
+    retire(it->second.allocation);
+    ds_set_cache.erase(it);
+    descriptor_cache_stats.evictions++;
+  }
 }
 
 VkDescriptorSet get_descriptor_set(VkCommandBuffer cmd,
@@ -841,24 +2939,53 @@ VkDescriptorSet get_descriptor_set(VkCommandBuffer cmd,
   assert(dh_count == program.n_bindings &&
          "[TSKGFX]: Bindings not compatible with program!");
 
-  // Murmur hash descriptors with program as seed.
-  uint32_t ds_hash;
-  tsk::murmur_hash3_x86_32(dhs, dh_count, ph, &ds_hash);
-  auto it = ds_set_cache.find(ds_hash);
+  // Key on the layout, descriptors and bound buffers and image views so sets
+  // are rebuilt when a resource is replaced (e.g. streamed mips or
+  // defragmentation). Zeroed as padding is compared.
+  DescriptorSetKeyVk key;
+  memset(&key, 0, sizeof(key));
+  key.layout = program.descriptor_set_layout;
+  key.dh_count = dh_count;
+  memcpy(key.dhs, dhs, dh_count * sizeof(DescriptorHandle));
 
-  if (it != ds_set_cache.end()) {
-    return it->second;
+  for (uint32_t i = 0; i < dh_count; i++) {
+    const DescriptorInfo& d_info = descriptor_set_info_cache[dhs[i]];
+    const uint16_t rh = d_info.resource_handle_index;
+
+    switch (d_info.type) {
+      case DescriptorType::k_uniform_buffer:
+      case DescriptorType::k_uniform_buffer_dynamic:
+      case DescriptorType::k_storage_buffer: {
+        const BufferVk& buffer =
+            rh == tsk::k_invalid_handle ? uniform_ring : buffer_cache[rh];
+        key.resources[i] = reinterpret_cast<uint64_t>(buffer.buffer);
+      } break;
+
+      case DescriptorType::k_combined_image_sampler:
+      case DescriptorType::k_storage_image: {
+        const TextureVk& texture = texture_cache[rh == tsk::k_invalid_handle
+                                                     ? white_rgba_th.idx
+                                                     : rh];
+        key.resources[i] = reinterpret_cast<uint64_t>(texture.image_view);
+      } break;
+
+      default:
+        break;
+    }
   }
 
-  // Allocate descriptor set.
-  VkDescriptorSetAllocateInfo alloc_info = {};
-  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  alloc_info.descriptorPool = descriptor_pool;
-  alloc_info.descriptorSetCount = 1;
-  alloc_info.pSetLayouts = &program.descriptor_set_layout;
+  auto it = ds_set_cache.find(key);
+
+  if (it != ds_set_cache.end()) {
+    it->second.last_used_frame = frame_number;
+    descriptor_cache_stats.hits++;
+    return it->second.allocation.set;
+  }
 
-  VkDescriptorSet ds;
-  VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &ds));
+  const DescriptorSetAllocationVk allocation =
+      allocate_descriptor_set(program.descriptor_set_layout);
+  const VkDescriptorSet ds = allocation.set;
+  descriptor_cache_stats.misses++;
 
   VkDescriptorImageInfo image_infos[k_max_desciptors] = {};
   VkDescriptorBufferInfo buffer_infos[k_max_desciptors] = {};
@@ -874,19 +3001,25 @@ VkDescriptorSet get_descriptor_set(VkCommandBuffer cmd,
     writes[i] = {};
     writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     writes[i].descriptorType = VkDescriptorType(d_info.type);
+    if (writes[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+      writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    }
     writes[i].descriptorCount = 1;
     writes[i].dstBinding = i;
     writes[i].dstSet = ds;
 
     switch (writes[i].descriptorType) {
       case (VK_DESCRIPTOR_TYPE_STORAGE_BUFFER):
-      case (VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER): {
-        const BufferVk& ub = buffer_cache[d_info.resource_handle_index];
+      case (VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC): {
+        // Dynamic uniforms without a resource read from the uniform ring.
+        const bool ring = d_info.resource_handle_index == tsk::k_invalid_handle;
+        const BufferVk& ub =
+            ring ? uniform_ring : buffer_cache[d_info.resource_handle_index];
 
         buffer_infos[i] = {};
         buffer_infos[i].buffer = ub.buffer;
         buffer_infos[i].offset = 0;
-        buffer_infos[i].range = VK_WHOLE_SIZE;
+        buffer_infos[i].range = ring ? k_max_uniform_size : VK_WHOLE_SIZE;
 
         writes[i].pBufferInfo = &buffer_infos[i];
       } break;
@@ -901,38 +3034,15 @@ VkDescriptorSet get_descriptor_set(VkCommandBuffer cmd,
 
         TextureVk& texture = texture_cache[th];
 
-        VkSamplerCreateInfo sampler_info = {};
-        sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        sampler_info.minFilter = VK_FILTER_NEAREST;
-        sampler_info.magFilter = VK_FILTER_NEAREST;
-
-        sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-        sampler_info.mipLodBias = 0;
-
-        sampler_info.anisotropyEnable = VK_FALSE;
-        sampler_info.maxAnisotropy = 0;
-
-        VkSampler sampler = VK_NULL_HANDLE;
-        VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr, &sampler));
-        texture_sampler_cache[dh] = sampler;
-
         image_infos[i] = {};
         image_infos[i].imageView = texture.image_view;
         image_infos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        image_infos[i].sampler = sampler;
+        image_infos[i].sampler = get_sampler(d_info.sampler).sampler;
 
         writes[i].pImageInfo = &image_infos[i];
 
-        // TODO: Move to texture update.
-        // Transition for use.
-        transition_image(cmd,
-                         texture.image,
-                         VK_IMAGE_ASPECT_COLOR_BIT,
-                         VK_IMAGE_LAYOUT_UNDEFINED,
-                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        // Transition textures that were never uploaded for use.
+        texture.transition(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
       } break;
 
       case (VK_DESCRIPTOR_TYPE_STORAGE_IMAGE): {
@@ -950,15 +3060,517 @@ VkDescriptorSet get_descriptor_set(VkCommandBuffer cmd,
 
   vkUpdateDescriptorSets(
       device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
-  return ds_set_cache[ds_hash] = ds;
+
+  ds_set_cache[key] = {allocation, frame_number};
+
+  return ds;
+}
+
+/// @brief Creates the descriptor buffer with a region of frame_size bytes per
+/// frame context.
+static void create_descriptor_buffer(VkDeviceSize frame_size) {
+  descriptor_buffer.create(
+      VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+          VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      k_frame_overlap * frame_size,
+      true);
+  descriptor_buffer.set_name("descriptor_buffer");
+  descriptor_buffer_data =
+      static_cast<uint8_t*>(descriptor_buffer.mapped_data());
+  descriptor_buffer_frame_size = frame_size;
+}
+
+/// @brief Grows the descriptor buffer so the region of a frame context holds
+/// at least frame_size bytes.
+///
+/// Descriptors written this frame are copied to the new buffer, the previous
+/// one is retired once the other frame context no longer reads it.
+static void grow_descriptor_buffer(VkDeviceSize frame_size) {
+  const BufferVk previous = descriptor_buffer;
+  const uint8_t* previous_region =
+      descriptor_buffer_data + current_frame * descriptor_buffer_frame_size;
+
+  descriptor_buffer = {};
+  create_descriptor_buffer(
+      std::max(descriptor_buffer_frame_size * 2, frame_size));
+  memcpy(descriptor_buffer_data + current_frame * descriptor_buffer_frame_size,
+         previous_region,
+         descriptor_buffer_head);
+  retire(previous);
+}
+
+/// @brief Writes the descriptors of a draw to the descriptor buffer region of
+/// the current frame context, growing it when full.
+///
+/// @returns Offset of the descriptors in the region, it moves if the buffer
+/// grows.
+static VkDeviceSize write_descriptor_buffer(VkCommandBuffer cmd,
+                                            const RenderDraw& draw) {
+  const ProgramVk& program = program_cache[draw.ph];
+  assert(draw.dh_count == program.n_bindings &&
+         "[TSKGFX]: Bindings not compatible with program!");
+
+  const VkDeviceSize alignment =
+      descriptor_buffer_properties.descriptorBufferOffsetAlignment;
+  const VkDeviceSize offset =
+      (descriptor_buffer_head + alignment - 1) & ~(alignment - 1);
+  if (offset + program.descriptor_buffer_size > descriptor_buffer_frame_size) {
+    grow_descriptor_buffer(offset + program.descriptor_buffer_size);
+  }
+  descriptor_buffer_head = offset + program.descriptor_buffer_size;
+
+  const VkDeviceSize buffer_offset =
+      current_frame * descriptor_buffer_frame_size + offset;
+
+  for (uint32_t i = 0; i < draw.dh_count; i++) {
+    const DescriptorInfo& d_info = descriptor_set_info_cache[draw.dhs[i]];
+    const uint16_t rh = d_info.resource_handle_index;
+
+    VkDescriptorGetInfoEXT get_info = {};
+    get_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+
+    VkDescriptorAddressInfoEXT address_info = {};
+    address_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+
+    VkDescriptorImageInfo image_info = {};
+    size_t size = 0;
+
+    switch (d_info.type) {
+      case DescriptorType::k_uniform_buffer:
+      case DescriptorType::k_uniform_buffer_dynamic: {
+        // Uniforms without a resource read from the uniform ring.
+        if (rh == tsk::k_invalid_handle) {
+          address_info.address = uniform_ring.address +
+                                 current_frame * k_max_frame_uniform_bytes +
+                                 draw.uniform_offset;
+          address_info.range = k_max_uniform_size;
+        } else {
+          address_info.address = buffer_cache[rh].address;
+          address_info.range = buffer_cache[rh].size();
+        }
+
+        get_info.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        get_info.data.pUniformBuffer = &address_info;
+        size = descriptor_buffer_properties.uniformBufferDescriptorSize;
+      } break;
+
+      case DescriptorType::k_storage_buffer: {
+        address_info.address = buffer_cache[rh].address;
+        address_info.range = buffer_cache[rh].size();
+
+        get_info.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        get_info.data.pStorageBuffer = &address_info;
+        size = descriptor_buffer_properties.storageBufferDescriptorSize;
+      } break;
+
+      case DescriptorType::k_combined_image_sampler: {
+        TextureVk& texture =
+            texture_cache[rh == tsk::k_invalid_handle ? white_rgba_th.idx : rh];
+
+        // Transition textures that were never uploaded for use.
+        texture.transition(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        image_info.sampler = get_sampler(d_info.sampler).sampler;
+        image_info.imageView = texture.image_view;
+        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        get_info.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        get_info.data.pCombinedImageSampler = &image_info;
+        size = descriptor_buffer_properties.combinedImageSamplerDescriptorSize;
+      } break;
+
+      case DescriptorType::k_storage_image: {
+        image_info.imageView = texture_cache[rh].image_view;
+        image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        get_info.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        get_info.data.pStorageImage = &image_info;
+        size = descriptor_buffer_properties.storageImageDescriptorSize;
+      } break;
+
+      default:
+        assert(false && "[TSKGFX]: Unsupported descriptor type!");
+        continue;
+    }
+
+    pfn_vkGetDescriptorEXT(device,
+                           &get_info,
+                           size,
+                           descriptor_buffer_data + buffer_offset +
+                               program.binding_offsets[i]);
+  }
+
+  return offset;
+}
+
+/// @brief Fills the data the update template of the draw's program pushes.
+static void write_push_descriptors(VkCommandBuffer cmd,
+                                   const RenderDraw& draw,
+                                   DescriptorUpdateDataVk* data) {
+  assert(draw.dh_count == program_cache[draw.ph].n_bindings &&
+         "[TSKGFX]: Bindings not compatible with program!");
+
+  // Zeroed as the data of consecutive draws is compared.
+  memset(data, 0, draw.dh_count * sizeof(DescriptorUpdateDataVk));
+
+  for (uint32_t i = 0; i < draw.dh_count; i++) {
+    const DescriptorInfo& d_info = descriptor_set_info_cache[draw.dhs[i]];
+    const uint16_t rh = d_info.resource_handle_index;
+
+    switch (d_info.type) {
+      case DescriptorType::k_uniform_buffer:
+      case DescriptorType::k_uniform_buffer_dynamic:
+      case DescriptorType::k_storage_buffer: {
+        // Uniforms without a resource read from the uniform ring.
+        if (rh == tsk::k_invalid_handle) {
+          data[i].buffer.buffer = uniform_ring.buffer;
+          data[i].buffer.offset =
+              current_frame * k_max_frame_uniform_bytes + draw.uniform_offset;
+          data[i].buffer.range = k_max_uniform_size;
+        } else {
+          data[i].buffer.buffer = buffer_cache[rh].buffer;
+          data[i].buffer.range = VK_WHOLE_SIZE;
+        }
+      } break;
+
+      case DescriptorType::k_combined_image_sampler: {
+        TextureVk& texture =
+            texture_cache[rh == tsk::k_invalid_handle ? white_rgba_th.idx : rh];
+
+        // Transition textures that were never uploaded for use.
+        texture.transition(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        data[i].image.sampler = get_sampler(d_info.sampler).sampler;
+        data[i].image.imageView = texture.image_view;
+        data[i].image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      } break;
+
+      case DescriptorType::k_storage_image: {
+        data[i].image.imageView = texture_cache[rh].image_view;
+        data[i].image.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+      } break;
+
+      default:
+        assert(false && "[TSKGFX]: Unsupported descriptor type!");
+        break;
+    }
+  }
+}
+
+/// @brief Gathers the dynamic offsets of a draw's descriptors in binding
+/// order.
+///
+/// @returns Number of dynamic offsets.
+static uint32_t get_dynamic_offsets(const RenderDraw& draw, uint32_t* offsets) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < draw.dh_count; i++) {
+    const DescriptorInfo& d_info = descriptor_set_info_cache[draw.dhs[i]];
+
+    switch (d_info.type) {
+      case DescriptorType::k_uniform_buffer:
+        offsets[count++] = 0;
+        break;
+
+      case DescriptorType::k_uniform_buffer_dynamic:
+        offsets[count++] =
+            d_info.resource_handle_index == tsk::k_invalid_handle
+                ? current_frame * k_max_frame_uniform_bytes +
+                      draw.uniform_offset
+                : 0;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return count;
+}
+
+/// @brief Creates the bindless set layout, its sets and the default sampler.
+///
+/// @note Must be called before any sampler is created.
+static void create_bindless_sets() {
+  const VkDescriptorBindingFlags binding_flag =
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+  const VkDescriptorBindingFlags binding_flags[3] = {
+      binding_flag, binding_flag, binding_flag};
+
+  VkDescriptorSetLayoutBinding bindings[3] = {};
+  bindings[0].binding = k_bindless_texture_binding;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  bindings[0].descriptorCount = k_max_bindless_textures;
+  bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+
+  bindings[1].binding = k_bindless_sampler_binding;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+  bindings[1].descriptorCount = k_max_bindless_samplers;
+  bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+  bindings[2].binding = k_bindless_buffer_binding;
+  bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[2].descriptorCount = k_max_bindless_buffers;
+  bindings[2].stageFlags = VK_SHADER_STAGE_ALL;
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {};
+  binding_flags_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  binding_flags_info.bindingCount = 3;
+  binding_flags_info.pBindingFlags = binding_flags;
+
+  VkDescriptorSetLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.pNext = &binding_flags_info;
+  layout_info.flags =
+      VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layout_info.bindingCount = 3;
+  layout_info.pBindings = bindings;
+  VK_CHECK(vkCreateDescriptorSetLayout(
+      device, &layout_info, nullptr, &bindless_set_layout));
+
+  // Layout to bind the set with, compatible with all program layouts.
+  VkPushConstantRange pc_range = {};
+  pc_range.stageFlags =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  pc_range.size = sizeof(DrawPushConstants);
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount = 1;
+  pipeline_layout_info.pSetLayouts = &bindless_set_layout;
+  pipeline_layout_info.pushConstantRangeCount = 1;
+  pipeline_layout_info.pPushConstantRanges = &pc_range;
+  VK_CHECK(vkCreatePipelineLayout(
+      device, &pipeline_layout_info, nullptr, &bindless_pipeline_layout));
+
+  const VkDescriptorPoolSize pool_sizes[3] = {
+      {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+       k_max_bindless_textures * k_frame_overlap},
+      {VK_DESCRIPTOR_TYPE_SAMPLER, k_max_bindless_samplers * k_frame_overlap},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       k_max_bindless_buffers * k_frame_overlap},
+  };
+
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  pool_info.maxSets = k_frame_overlap;
+  pool_info.poolSizeCount = 3;
+  pool_info.pPoolSizes = pool_sizes;
+  VK_CHECK(
+      vkCreateDescriptorPool(device, &pool_info, nullptr, &bindless_pool));
+
+  VkDescriptorSetLayout set_layouts[k_frame_overlap];
+  for (VkDescriptorSetLayout& set_layout : set_layouts) {
+    set_layout = bindless_set_layout;
+  }
+
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = bindless_pool;
+  alloc_info.descriptorSetCount = k_frame_overlap;
+  alloc_info.pSetLayouts = set_layouts;
+  VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, bindless_sets));
+
+  // Sampler 0 is the default sampler.
+  get_sampler(SamplerInfo{});
+}
+
+/// @brief Writes the slots changed since the current frame context last
+/// recorded to its bindless set.
+///
+/// @attention The frame context must have retired.
+static void update_bindless_set(VkCommandBuffer cmd) {
+  std::vector<TextureHandle>& dirty_textures =
+      bindless_dirty_textures[current_frame];
+  std::vector<BufferHandle>& dirty_buffers =
+      bindless_dirty_buffers[current_frame];
+
+  std::vector<SamplerVk>& dirty_samplers =
+      bindless_dirty_samplers[current_frame];
+
+  // Reserved so the infos referenced by writes are never reallocated.
+  std::vector<VkDescriptorImageInfo> image_infos;
+  std::vector<VkDescriptorBufferInfo> buffer_infos;
+  image_infos.reserve(dirty_textures.size() + dirty_samplers.size());
+  buffer_infos.reserve(dirty_buffers.size());
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.reserve(image_infos.capacity() + buffer_infos.capacity());
+
+  VkWriteDescriptorSet write = {};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = bindless_sets[current_frame];
+  write.descriptorCount = 1;
+
+  // Destroyed resources keep their slot, partially bound slots may be stale
+  // as long as shaders do not access them.
+  for (TextureHandle th : dirty_textures) {
+    // The texture array is declared texture2D[], other view types keep no
+    // slot and are bound through program descriptors.
+    TextureVk& texture = texture_cache[th];
+    if (!texture.valid() || texture.view_type != VK_IMAGE_VIEW_TYPE_2D) {
+      continue;
+    }
+
+    // Transition textures that were never uploaded for use.
+    texture.transition(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    VkDescriptorImageInfo& info = image_infos.emplace_back();
+    info = {};
+    info.imageView = texture.image_view;
+    info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    write.dstBinding = k_bindless_texture_binding;
+    write.dstArrayElement = th.idx;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    write.pImageInfo = &info;
+    write.pBufferInfo = nullptr;
+    writes.push_back(write);
+  }
+  dirty_textures.clear();
+
+  for (const SamplerVk& sampler : dirty_samplers) {
+    VkDescriptorImageInfo& info = image_infos.emplace_back();
+    info = {};
+    info.sampler = sampler.sampler;
+
+    write.dstBinding = k_bindless_sampler_binding;
+    write.dstArrayElement = sampler.bindless_index;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    write.pImageInfo = &info;
+    write.pBufferInfo = nullptr;
+    writes.push_back(write);
+  }
+  dirty_samplers.clear();
+
+  for (BufferHandle bh : dirty_buffers) {
+    const BufferVk& buffer = buffer_cache[bh];
+    if (!buffer.valid()) {
+      continue;
+    }
+
+    VkDescriptorBufferInfo& info = buffer_infos.emplace_back();
+    info = {};
+    info.buffer = buffer.buffer;
+    info.range = VK_WHOLE_SIZE;
+
+    write.dstBinding = k_bindless_buffer_binding;
+    write.dstArrayElement = bh.idx;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pImageInfo = nullptr;
+    write.pBufferInfo = &info;
+    writes.push_back(write);
+  }
+  dirty_buffers.clear();
+
+  if (!writes.empty()) {
+    vkUpdateDescriptorSets(device,
+                           static_cast<uint32_t>(writes.size()),
+                           writes.data(),
+                           0,
+                           nullptr);
+  }
+}
+
+/// @brief Retires cached descriptor sets that reference the descriptor.
+static void retire_descriptor_sets(DescriptorHandle dh) {
+  for (auto it = ds_set_cache.begin(); it != ds_set_cache.end();) {
+    const DescriptorSetKeyVk& key = it->first;
+    if (std::find(key.dhs, key.dhs + key.dh_count, dh) ==
+        key.dhs + key.dh_count) {
+      ++it;
+      continue;
+    }
+
+    retire(it->second.allocation);
+    it = ds_set_cache.erase(it);
+  }
+}
+
+/// @brief Retires cached descriptor sets that reference the resource.
+static void retire_descriptor_sets(uint16_t rh, bool texture) {
+  for (uint32_t dh = 0; dh < 512; dh++) {
+    const DescriptorInfo& d_info = descriptor_set_info_cache[dh];
+    if (d_info.type == DescriptorType::k_max_enum ||
+        d_info.resource_handle_index != rh) {
+      continue;
+    }
+
+    const bool texture_descriptor =
+        d_info.type == DescriptorType::k_combined_image_sampler ||
+        d_info.type == DescriptorType::k_sampled_image ||
+        d_info.type == DescriptorType::k_storage_image;
+    if (texture_descriptor == texture) {
+      retire_descriptor_sets(DescriptorHandle{static_cast<uint16_t>(dh)});
+    }
+  }
+}
+
+void DeletionQueueVk::flush() {
+  for (BufferVk& buffer : buffers) {
+    buffer.destroy();
+  }
+  buffers.clear();
+
+  for (TextureVk& texture : textures) {
+    texture.destroy();
+  }
+  textures.clear();
+
+  for (VkPipeline pipeline : pipelines) {
+    vkDestroyPipeline(device, pipeline, nullptr);
+  }
+  pipelines.clear();
+
+  for (VkPipelineLayout layout : pipeline_layouts) {
+    vkDestroyPipelineLayout(device, layout, nullptr);
+  }
+  pipeline_layouts.clear();
+
+  for (VkDescriptorSetLayout layout : descriptor_set_layouts) {
+    vkDestroyDescriptorSetLayout(device, layout, nullptr);
+  }
+  descriptor_set_layouts.clear();
+
+  for (VkDescriptorUpdateTemplate update_template : update_templates) {
+    vkDestroyDescriptorUpdateTemplate(device, update_template, nullptr);
+  }
+  update_templates.clear();
+
+  for (MeshVk& mesh : meshes) {
+    mesh.destroy();
+  }
+  meshes.clear();
+
+  for (const DescriptorSetAllocationVk& allocation : descriptor_sets) {
+    vkFreeDescriptorSets(device, allocation.pool, 1, &allocation.set);
+  }
+  descriptor_sets.clear();
 }
 
 // TODO: Move to Client.
 ProgramVk compute_program;
 
 bool RenderContextVk::init(const AppConfig& app_config) {
-  // Store config.
+  const auto init_start = std::chrono::steady_clock::now();
+
+  // Store config, the pipeline cache path may not outlive init.
   config = app_config;
+  pipeline_cache_path =
+      app_config.pipeline_cache_path ? app_config.pipeline_cache_path : "";
+  config.pipeline_cache_path = nullptr;
+  pso_usage_path = app_config.pso_usage_path ? app_config.pso_usage_path : "";
+  config.pso_usage_path = nullptr;
+  warmup_start = init_start;
+
+  // A missing or invalid pack falls back to shader files.
+  if (app_config.shader_pack_path != nullptr) {
+    shader_pack.open(app_config.shader_pack_path);
+  }
+  config.shader_pack_path = nullptr;
 
   // Build context.
   vkb::InstanceBuilder instance_builder;
@@ -996,6 +3608,16 @@ bool RenderContextVk::init(const AppConfig& app_config) {
   features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
   features12.bufferDeviceAddress = true;
 
+  if (app_config.bindless) {
+    features12.descriptorIndexing = true;
+    features12.runtimeDescriptorArray = true;
+    features12.descriptorBindingPartiallyBound = true;
+    features12.descriptorBindingSampledImageUpdateAfterBind = true;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = true;
+    features12.shaderSampledImageArrayNonUniformIndexing = true;
+    features12.shaderStorageBufferArrayNonUniformIndexing = true;
+  }
+
   vkb::PhysicalDeviceSelector selector{vkb_instance};
   vkb::PhysicalDevice vkb_physical_device =
       selector.set_minimum_version(1, 3)
@@ -1005,12 +3627,169 @@ bool RenderContextVk::init(const AppConfig& app_config) {
           .select()
           .value();
 
+  // Optional extensions.
+  const bool memory_budget_supported =
+      vkb_physical_device.enable_extension_if_present(
+          VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  // Descriptor buffers replace cached sets, bindless keeps its sets.
+  VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptor_buffer_features = {};
+  descriptor_buffer_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+  descriptor_buffer_features.descriptorBuffer = true;
+
+  descriptor_buffer_enabled =
+      !app_config.bindless &&
+      vkb_physical_device.is_extension_present(
+          VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME) &&
+      vkb_physical_device.enable_extension_features_if_present(
+          descriptor_buffer_features) &&
+      vkb_physical_device.enable_extension_if_present(
+          VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+
+  push_descriptor_enabled =
+      !descriptor_buffer_enabled &&
+      vkb_physical_device.enable_extension_if_present(
+          VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+
+  // Topology, cull and depth state are dynamic in core 1.3, blending requires
+  // extended dynamic state 3.
+  VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamic_state3_features =
+      {};
+  dynamic_state3_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+  dynamic_state3_features.extendedDynamicState3ColorBlendEnable = true;
+  dynamic_state3_features.extendedDynamicState3ColorBlendEquation = true;
+
+  const bool dynamic_blend_enabled =
+      app_config.dynamic_state &&
+      vkb_physical_device.is_extension_present(
+          VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME) &&
+      vkb_physical_device.enable_extension_features_if_present(
+          dynamic_state3_features) &&
+      vkb_physical_device.enable_extension_if_present(
+          VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+
+  // Pipelines are linked from libraries only if linking is fast.
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipeline_library_features =
+      {};
+  pipeline_library_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+  pipeline_library_features.graphicsPipelineLibrary = true;
+
+  pipeline_library_enabled =
+      vkb_physical_device.is_extension_present(
+          VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+      vkb_physical_device.enable_extension_features_if_present(
+          pipeline_library_features) &&
+      vkb_physical_device.enable_extension_if_present(
+          VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+      vkb_physical_device.enable_extension_if_present(
+          VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+  if (app_config.dynamic_state) {
+    dynamic_state_bits =
+        k_state_topology_bits | k_state_cull_bits | k_state_depth_bits;
+  }
+  if (dynamic_blend_enabled) {
+    dynamic_state_bits |= k_state_blend_bits;
+  }
+
+  // Optional features.
+  VkPhysicalDeviceFeatures optional_features = {};
+  optional_features.samplerAnisotropy = true;
+  if (vkb_physical_device.enable_features_if_present(optional_features)) {
+    max_sampler_anisotropy =
+        vkb_physical_device.properties.limits.maxSamplerAnisotropy;
+  }
+
+  VkPhysicalDeviceFeatures cube_array_features = {};
+  cube_array_features.imageCubeArray = true;
+  cube_array_enabled =
+      vkb_physical_device.enable_features_if_present(cube_array_features);
+
   vkb::DeviceBuilder device_builder{vkb_physical_device};
   vkb::Device vkb_device = device_builder.build().value();
 
   physical_device = vkb_physical_device.physical_device;
   device = vkb_device;
 
+  if (descriptor_buffer_enabled) {
+    descriptor_buffer_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &descriptor_buffer_properties;
+    vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+    pfn_vkGetDescriptorSetLayoutSizeEXT =
+        reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(
+            vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutSizeEXT"));
+    pfn_vkGetDescriptorSetLayoutBindingOffsetEXT =
+        reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(
+            vkGetDeviceProcAddr(device,
+                                "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+    pfn_vkGetDescriptorEXT = reinterpret_cast<PFN_vkGetDescriptorEXT>(
+        vkGetDeviceProcAddr(device, "vkGetDescriptorEXT"));
+    pfn_vkCmdBindDescriptorBuffersEXT =
+        reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(
+            vkGetDeviceProcAddr(device, "vkCmdBindDescriptorBuffersEXT"));
+    pfn_vkCmdSetDescriptorBufferOffsetsEXT =
+        reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(
+            vkGetDeviceProcAddr(device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+  }
+
+  if (dynamic_blend_enabled) {
+    VkPhysicalDeviceExtendedDynamicState3PropertiesEXT
+        dynamic_state3_properties = {};
+    dynamic_state3_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &dynamic_state3_properties;
+    vkGetPhysicalDeviceProperties2(physical_device, &properties);
+    dynamic_topology_unrestricted =
+        dynamic_state3_properties.dynamicPrimitiveTopologyUnrestricted;
+
+    pfn_vkCmdSetColorBlendEnableEXT =
+        reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(
+            vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEnableEXT"));
+    pfn_vkCmdSetColorBlendEquationEXT =
+        reinterpret_cast<PFN_vkCmdSetColorBlendEquationEXT>(
+            vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEquationEXT"));
+  }
+
+  if (pipeline_library_enabled) {
+    VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT
+        pipeline_library_properties = {};
+    pipeline_library_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &pipeline_library_properties;
+    vkGetPhysicalDeviceProperties2(physical_device, &properties);
+    pipeline_library_enabled =
+        pipeline_library_properties.graphicsPipelineLibraryFastLinking;
+  }
+
+  pipeline_cache_stats.dynamic_state = dynamic_state_bits != 0;
+  pipeline_cache_stats.dynamic_blend = dynamic_blend_enabled;
+  pipeline_cache_stats.pipeline_library = pipeline_library_enabled;
+
+  if (push_descriptor_enabled) {
+    pfn_vkCmdPushDescriptorSetWithTemplateKHR =
+        reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(
+            vkGetDeviceProcAddr(device,
+                                "vkCmdPushDescriptorSetWithTemplateKHR"));
+  }
+
+  create_pipeline_cache();
+  load_pso_usage();
+  pipeline_workers.start();
+
   // Build swapchain and swapchain images.
   rebuild_swapchain(
       physical_device, device, surface, app_config.width, app_config.height);
@@ -1090,26 +3869,32 @@ bool RenderContextVk::init(const AppConfig& app_config) {
   allocator_info.instance = instance;
   allocator_info.physicalDevice = physical_device;
   allocator_info.device = device;
+  allocator_info.vulkanApiVersion = VK_API_VERSION_1_3;
   allocator_info.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+  if (memory_budget_supported) {
+    allocator_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+  }
   VK_CHECK(vmaCreateAllocator(&allocator_info, &allocator));
 
-  // TODO: Allocate based on shaders.
-  // Create descriptor pools and descriptors.
-  std::vector<VkDescriptorPoolSize> pool_sizes = {
-      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 32},
+  // Create the first descriptor pool of the chain, later pools are sized
+  // from the reflected bindings of created programs.
+  descriptor_pool = create_descriptor_pool();
 
-      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 32},
-      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 32},
-  };
+  if (app_config.bindless) {
+    create_bindless_sets();
+  }
 
-  VkDescriptorPoolCreateInfo pool_info = {};
-  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-  pool_info.maxSets = k_max_desciptors;
-  pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
-  pool_info.pPoolSizes = pool_sizes.data();
-  VK_CHECK(
-      vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool));
+  uniform_ring.create(
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+      k_frame_overlap * k_max_frame_uniform_bytes + k_max_uniform_size,
+      true);
+  uniform_ring.set_name("uniform_ring");
+  uniform_ring_data = static_cast<uint8_t*>(uniform_ring.mapped_data());
+
+  if (descriptor_buffer_enabled) {
+    create_descriptor_buffer(k_descriptor_buffer_frame_size);
+  }
 
   // Rendering resources.
   assert(app_config.width * app_config.height != 0 &&
@@ -1133,6 +3918,9 @@ bool RenderContextVk::init(const AppConfig& app_config) {
                              VK_FORMAT_D32_SFLOAT,
                              VK_IMAGE_ASPECT_DEPTH_BIT);
 
+  final_color_texture.set_name("final_color");
+  final_depth_texture.set_name("final_depth");
+
   // TODO: Move to Client.
   // Create compute pipeline.
   {
@@ -1154,9 +3942,13 @@ bool RenderContextVk::init(const AppConfig& app_config) {
     // TODO: Delete.
     uint8_t* white_data = static_cast<uint8_t*>(malloc(256 * 256 * 4));
     memset(white_data, 0xFF, 256 * 256 * 4);
-    tsk::update(white_rgba_th, 0, sizeof(white_data), white_data);
+    tsk::update(white_rgba_th, 0, 256 * 256 * 4, white_data);
   }
 
+  const std::chrono::duration<float, std::milli> init_elapsed =
+      std::chrono::steady_clock::now() - init_start;
+  pipeline_cache_stats.init_ms = init_elapsed.count();
+
   return true;
 }
 
@@ -1164,32 +3956,86 @@ void RenderContextVk::shutdown() {
   // Wait for device to finish commands.
   vkDeviceWaitIdle(device);
 
-  // Managed
-  for (VkSampler sampler : texture_sampler_cache) {
-    if (sampler == VK_NULL_HANDLE) {
-      continue;
+  // Finish an in flight defragmentation pass, the device is idle.
+  if (defrag_context != VK_NULL_HANDLE) {
+    if (defrag_pass_frame != -1) {
+      current_frame = defrag_pass_frame;
+      end_defragmentation_pass();
     }
 
-    vkDestroySampler(device, sampler, nullptr);
+    if (defrag_context != VK_NULL_HANDLE) {
+      finish_defragmentation();
+    }
   }
 
-  for (auto it : ds_set_cache) {
-    VkDescriptorSet ds = it.second;
-    vkFreeDescriptorSets(device, descriptor_pool, 1, &ds);
+  // Managed
+  for (const auto& [info, sampler] : sampler_cache) {
+    vkDestroySampler(device, sampler.sampler, nullptr);
   }
+  sampler_cache.clear();
+
+  // Cached sets are freed with their pools.
+  ds_set_cache.clear();
+
+  // Finish compiling, pipelines of destroyed programs are queued for deletion.
+  pipeline_workers.stop();
+  collect_pipelines();
+
+  save_pipeline_cache();
+  save_pso_usage();
+  pso_usage.clear();
+  recorded_pso_usage.clear();
+  warming_pipelines.clear();
+
+  vkDestroyPipelineCache(device, device_pipeline_cache, nullptr);
+  device_pipeline_cache = VK_NULL_HANDLE;
 
   for (auto it : pipeline_cache) {
     VkPipeline pipeline = it.second;
     vkDestroyPipeline(device, pipeline, nullptr);
   }
+  pipeline_cache.clear();
+
+  // Modules of destroyed shaders still referenced by programs.
+  for (VkShaderModule module : retired_shader_modules) {
+    vkDestroyShaderModule(device, module, nullptr);
+  }
+  retired_shader_modules.clear();
+  shader_module_refs.clear();
+  shader_pack.close();
 
   destroy(white_rgba_th);
 
   final_depth_texture.destroy();
   final_color_texture.destroy();
 
+  for (DeletionQueueVk& queue : deletion_queues) {
+    queue.flush();
+  }
+
+  for (int i = 0; i < mesh_arena_count; i++) {
+    mesh_arenas[i].vertices.destroy();
+    mesh_arenas[i].indices.destroy();
+  }
+
+  uniform_ring.destroy();
+
+  if (descriptor_buffer.valid()) {
+    descriptor_buffer.destroy();
+  }
+
   vmaDestroyAllocator(allocator);
-  vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+
+  for (VkDescriptorPool pool : descriptor_pools) {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  }
+  descriptor_pools.clear();
+
+  if (config.bindless) {
+    vkDestroyDescriptorPool(device, bindless_pool, nullptr);
+    vkDestroyPipelineLayout(device, bindless_pipeline_layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, bindless_set_layout, nullptr);
+  }
 
   // Clean frame context.
   for (int i = 0; i < k_frame_overlap; i++) {
@@ -1223,20 +4069,33 @@ void RenderContextVk::frame() {
       device, 1, &render_fence[current_frame], VK_TRUE, UINT64_MAX));
   VK_CHECK(vkResetFences(device, 1, &render_fence[current_frame]));
 
-  // Destroy last frame transient resources.
-  for (int i = 0; i < transient_buffer_destroy_queue_count; i++) {
-    int transient_buffer_idx = transient_buffer_destroy_queue[i];
-    transient_buffers[transient_buffer_idx].destroy();
+  // Warn once per heap when its usage crosses the threshold.
+  if (memory_warning_fn != nullptr) {
+    const MemoryStats stats = get_memory_stats();
+    for (uint32_t heap = 0; heap < stats.heap_count; heap++) {
+      const MemoryHeapStats& heap_stats = stats.heaps[heap];
+      const bool over = heap_stats.usage > heap_stats.budget *
+                                               double(memory_warning_threshold);
 
-    transient_buffer_count--;
-  }
-  transient_buffer_destroy_queue_count = 0;
+      if (over && (memory_warning_heaps & (1u << heap)) == 0) {
+        memory_warning_fn(stats, heap);
+      }
 
-  // Queue transient resources for destruction.
-  for (int i = 0; i < transient_buffer_count; i++) {
-    transient_buffer_destroy_queue[transient_buffer_destroy_queue_count++] = i;
+      memory_warning_heaps = over ? memory_warning_heaps | (1u << heap)
+                                  : memory_warning_heaps & ~(1u << heap);
+    }
   }
 
+  end_defragmentation_pass();
+
+  // Destroy objects released while this context was in flight.
+  deletion_queues[current_frame].flush();
+
+  collect_pipelines();
+  warm_up_pipelines();
+
+  descriptor_buffer_head = 0;
+
   // Request image index to render to and signal swapchain_semaphore.
   uint32_t swapchain_index;
   VkResult sc_acquire_res =
@@ -1259,9 +4118,34 @@ void RenderContextVk::frame() {
   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
   begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
   VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+  recording_frame = true;
+
+  if (defrag_context != VK_NULL_HANDLE && defrag_pass_frame == -1) {
+    record_defragmentation_pass(cmd);
+  }
 
   // ~ Updated Resources ~
   // TODO: Pool to resource udpates to single pipeline barrier.
+  for (int i = 0; i < dirty_meshes_head; i++) {
+    const MeshUpdateVk& mesh_update = dirty_meshes[i];
+
+    const MeshVk& mesh = mesh_cache[mesh_update.mh];
+    if (!mesh.valid()) {
+      continue;
+    }
+
+    MeshArenaVk& arena = mesh_arenas[mesh.arena];
+    arena.vertices.update(cmd,
+                          static_cast<uint32_t>(mesh.vertices.offset),
+                          mesh_update.vertices_size,
+                          const_cast<void*>(mesh_update.vertices));
+    arena.indices.update(cmd,
+                         static_cast<uint32_t>(mesh.indices.offset),
+                         mesh.index_count * sizeof(uint32_t),
+                         const_cast<uint32_t*>(mesh_update.indices));
+  }
+  dirty_meshes_head = 0;
+
   for (int i = 0; i < dirty_buffers_head; i++) {
     BufferHandle bh = dirty_buffers[i];
 
@@ -1275,20 +4159,34 @@ void RenderContextVk::frame() {
   dirty_buffers_head = 0;
 
   for (int i = 0; i < dirty_textures_head; i++) {
-    TextureHandle th = dirty_textures[i];
+    const TextureUpdateVk& texture_update = dirty_textures[i];
+    TextureHandle th = texture_update.th;
 
     TextureVk& texture = texture_cache[th];
-    void* data = texture_data_ptrs[th];
+    void* data = texture_update.data;
+
+    // Streaming textures keep their data to stream mips from.
+    StreamingTextureVk& stream = texture_streams[th];
+    if (stream.valid()) {
+      stream.data = static_cast<const uint8_t*>(data);
+      upload_mips(cmd, texture, stream, stream.resident_mip, stream.num_mips);
+      texture.transition(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      continue;
+    }
 
-    uint32_t format_size = 4;
-    texture.update(cmd,
-                   0,
-                   texture.extent.width * texture.extent.height *
-                       texture.extent.depth * format_size,
-                   texture_data_ptrs[th]);
+    const uint32_t num_layers = texture_update.num_layers == UINT16_MAX
+                                    ? texture.array_layers
+                                    : texture_update.num_layers;
+    texture.update(cmd, texture_update.first_layer, num_layers, data);
   }
   dirty_textures_head = 0;
 
+  update_texture_streaming(cmd);
+
+  if (config.bindless) {
+    update_bindless_set(cmd);
+  }
+
   transition_image(cmd,
                    final_color_texture.image,
                    VK_IMAGE_ASPECT_COLOR_BIT,
@@ -1367,35 +4265,129 @@ void RenderContextVk::frame() {
     rendering_info.pColorAttachments = &color_attachment_info;
     rendering_info.pDepthAttachment = &depth_attachment_info;
 
-    static VkDescriptorSet ds_sets_consumable[128] = {VK_NULL_HANDLE};
+    static VkDescriptorSet ds_sets_consumable[k_max_draws] = {VK_NULL_HANDLE};
+    static VkDeviceSize db_offsets_consumable[k_max_draws] = {};
+    static DescriptorUpdateDataVk
+        push_data_consumable[k_max_draws][k_max_push_descriptor_bindings];
 
-    // Updated and store descriptor sets.
+    evict_descriptor_sets();
+    resolve_pending_draws(render_frame);
+
+    // Updated and store descriptor sets, or write the descriptors of draws
+    // to the descriptor buffer or their push data. Draws binding the same as
+    // the previous draw share its descriptors.
     for (uint32_t i = 0; i < render_frame->draw_count; i++) {
       RenderDraw& draw = render_frame->draws[i];
-      ds_sets_consumable[i] =
-          get_descriptor_set(cmd, draw.ph, draw.dhs, draw.dh_count);
+
+      if (program_cache[draw.ph].push_descriptors) {
+        write_push_descriptors(cmd, draw, push_data_consumable[i]);
+        continue;
+      }
+
+      // Programs without bindings bind no set.
+      if (!descriptor_buffer_enabled) {
+        ds_sets_consumable[i] =
+            program_cache[draw.ph].n_bindings > 0
+                ? get_descriptor_set(cmd, draw.ph, draw.dhs, draw.dh_count)
+                : VK_NULL_HANDLE;
+        continue;
+      }
+
+      const RenderDraw* previous =
+          i > 0 ? &render_frame->draws[i - 1] : nullptr;
+      if (previous != nullptr && previous->ph == draw.ph &&
+          previous->dh_count == draw.dh_count &&
+          previous->uniform_offset == draw.uniform_offset &&
+          memcmp(previous->dhs,
+                 draw.dhs,
+                 draw.dh_count * sizeof(DescriptorHandle)) == 0) {
+        db_offsets_consumable[i] = db_offsets_consumable[i - 1];
+        continue;
+      }
+
+      db_offsets_consumable[i] = write_descriptor_buffer(cmd, draw);
+    }
+
+    // Upload the frame's uniforms to its region of the ring.
+    if (render_frame->uniform_size > 0) {
+      const VkDeviceSize region = current_frame * k_max_frame_uniform_bytes;
+      memcpy(uniform_ring_data + region,
+             render_frame->uniform_data,
+             render_frame->uniform_size);
+      vmaFlushAllocation(allocator,
+                         uniform_ring.vma_allocation(),
+                         region,
+                         render_frame->uniform_size);
+      render_frame->uniform_size = 0;
     }
 
     vkCmdBeginRendering(cmd, &rendering_info);
 
+    // Program layouts are compatible up to the bindless set, it stays bound
+    // across pipeline changes.
+    if (config.bindless) {
+      vkCmdBindDescriptorSets(cmd,
+                              VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              bindless_pipeline_layout,
+                              k_bindless_set,
+                              1,
+                              &bindless_sets[current_frame],
+                              0,
+                              nullptr);
+    }
+
+    if (descriptor_buffer_enabled) {
+      // The descriptor buffer may not be host coherent, flush the
+      // descriptors written this frame.
+      if (descriptor_buffer_head > 0) {
+        vmaFlushAllocation(allocator,
+                           descriptor_buffer.vma_allocation(),
+                           current_frame * descriptor_buffer_frame_size,
+                           descriptor_buffer_head);
+      }
+
+      VkDescriptorBufferBindingInfoEXT binding_info = {};
+      binding_info.sType =
+          VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+      binding_info.address = descriptor_buffer.address;
+      binding_info.usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+                           VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+      pfn_vkCmdBindDescriptorBuffersEXT(cmd, 1, &binding_info);
+    }
+
     ProgramHandle last_ph;
+    VkPipeline last_pipeline = VK_NULL_HANDLE;
+    uint32_t last_state = UINT32_MAX;  // All set by the first draw.
+    VkDeviceSize last_db_offset = VK_WHOLE_SIZE;
+    const DescriptorUpdateDataVk* last_push_data = nullptr;
+    VkDescriptorSet last_ds = VK_NULL_HANDLE;
+    uint32_t last_offsets[k_max_program_set_bindings] = {};
+    uint32_t last_offset_count = 0;
+    VkBuffer last_index_buffer = VK_NULL_HANDLE;
     for (uint32_t draw_count = 0; draw_count < render_frame->draw_count;
          draw_count++) {
       RenderDraw& draw = render_frame->draws[draw_count];
       const ProgramVk program = program_cache[draw.ph];
 
+      // States of a program share its layout, bound sets stay valid.
+      if (last_pipeline != draw_pipelines[draw_count]) {
+        vkCmdBindPipeline(cmd,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          draw_pipelines[draw_count]);
+        last_pipeline = draw_pipelines[draw_count];
+      }
+
+      // Dynamic state persists across pipeline changes.
+      const uint32_t state = pack_render_state(draw.state);
+      if (dynamic_state_bits != 0 && state != last_state) {
+        set_dynamic_state(
+            cmd,
+            draw.state,
+            last_state == UINT32_MAX ? UINT32_MAX : state ^ last_state);
+        last_state = state;
+      }
+
       if (last_ph != draw.ph) {
-        vkCmdBindPipeline(
-            cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, get_pipeline(program));
-        vkCmdBindDescriptorSets(cmd,
-                                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                program.pipeline_layout,
-                                0,
-                                1,
-                                &ds_sets_consumable[draw_count],
-                                0,
-                                &offsets);
-
         VkViewport viewport = {
             0.0f,
             0.0f,
@@ -1411,6 +4403,67 @@ void RenderContextVk::frame() {
         vkCmdSetScissor(cmd, 0, 1, &scissor);
 
         last_ph = draw.ph;
+        last_ds = VK_NULL_HANDLE;
+        last_db_offset = VK_WHOLE_SIZE;
+        last_push_data = nullptr;
+      }
+
+      if (program.push_descriptors) {
+        // Push only when the bindings differ from the last pushed.
+        const DescriptorUpdateDataVk* push_data =
+            push_data_consumable[draw_count];
+        if (last_push_data == nullptr ||
+            memcmp(last_push_data,
+                   push_data,
+                   program.n_bindings * sizeof(DescriptorUpdateDataVk)) != 0) {
+          pfn_vkCmdPushDescriptorSetWithTemplateKHR(
+              cmd,
+              program.update_template,
+              program.pipeline_layout,
+              config.bindless ? k_bindless_program_set : 0,
+              push_data);
+          last_push_data = push_data;
+        }
+      } else if (descriptor_buffer_enabled) {
+        if (last_db_offset != db_offsets_consumable[draw_count]) {
+          const uint32_t buffer_index = 0;
+          const VkDeviceSize offset =
+              current_frame * descriptor_buffer_frame_size +
+              db_offsets_consumable[draw_count];
+          pfn_vkCmdSetDescriptorBufferOffsetsEXT(
+              cmd,
+              VK_PIPELINE_BIND_POINT_GRAPHICS,
+              program.pipeline_layout,
+              0,
+              1,
+              &buffer_index,
+              &offset);
+          last_db_offset = db_offsets_consumable[draw_count];
+        }
+      } else if (program.n_bindings > 0) {
+        // Rebind the set when it or its dynamic offsets change.
+        uint32_t dynamic_offsets[k_max_program_set_bindings] = {};
+        const uint32_t offset_count =
+            get_dynamic_offsets(draw, dynamic_offsets);
+
+        if (last_ds != ds_sets_consumable[draw_count] ||
+            last_offset_count != offset_count ||
+            memcmp(last_offsets,
+                   dynamic_offsets,
+                   offset_count * sizeof(uint32_t)) != 0) {
+          vkCmdBindDescriptorSets(cmd,
+                                  VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                  program.pipeline_layout,
+                                  config.bindless ? k_bindless_program_set : 0,
+                                  1,
+                                  &ds_sets_consumable[draw_count],
+                                  offset_count,
+                                  dynamic_offsets);
+
+          last_ds = ds_sets_consumable[draw_count];
+          last_offset_count = offset_count;
+          memcpy(last_offsets, dynamic_offsets, sizeof(dynamic_offsets));
+        }
       }
 
       DrawPushConstants pc = {};
@@ -1418,19 +4471,40 @@ void RenderContextVk::frame() {
       memcpy(pc.model, draw.transform_matrix, sizeof(float) * 16);
       memcpy(pc.camera_pos, draw.camera_pos, sizeof(float) * 3);
 
-      const BufferVk& vb = buffer_cache[draw.vbh];
-      pc.vbo = vb.address;
+      // Meshes share the index buffer of their arena and are drawn by offset.
+      VkBuffer index_buffer = VK_NULL_HANDLE;
+      uint32_t index_count = 0;
+      uint32_t first_index = 0;
+
+      if (draw.mh.idx != k_invalid_handle) {
+        const MeshVk& mesh = mesh_cache[draw.mh];
+        const MeshArenaVk& arena = mesh_arenas[mesh.arena];
+        pc.vbo = arena.vertices.address + mesh.vertices.offset;
+
+        index_buffer = arena.indices.buffer;
+        index_count = mesh.index_count;
+        first_index = mesh.first_index();
+      } else {
+        const BufferVk& vb = buffer_cache[draw.vbh];
+        pc.vbo = vb.address;
+
+        const BufferVk& ib = buffer_cache[draw.ibh];
+        index_buffer = ib.buffer;
+        index_count = static_cast<uint32_t>(ib.size() / sizeof(uint32_t));
+      }
 
-      const BufferVk& ib = buffer_cache[draw.ibh];
-      vkCmdBindIndexBuffer(cmd, ib.buffer, 0, VK_INDEX_TYPE_UINT32);
+      if (last_index_buffer != index_buffer) {
+        vkCmdBindIndexBuffer(cmd, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+        last_index_buffer = index_buffer;
+      }
 
       vkCmdPushConstants(cmd,
                          program.pipeline_layout,
-                         VK_SHADER_STAGE_VERTEX_BIT,
+                         program.pc_stages,
                          0,
                          sizeof(DrawPushConstants),
                          &pc);
-      vkCmdDrawIndexed(cmd, ib.size() / sizeof(uint32_t), 1, 0, 0, 0);
+      vkCmdDrawIndexed(cmd, index_count, 1, first_index, 0, 0);
 
       draw.clear();
     }
@@ -1502,6 +4576,8 @@ void RenderContextVk::frame() {
 
   // Submit and signal render fence when complete.
   vkQueueSubmit2(graphics_queue, 1, &submit, render_fence[current_frame]);
+  recording_frame = false;
+  submitted_frame = current_frame;
 
   VkPresentInfoKHR present_info = {};
   present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1521,10 +4597,11 @@ void RenderContextVk::frame() {
 
   // Increase frame.
   current_frame = (current_frame + 1) % 2;
+  frame_number++;
 }
 
-void RenderContextVk::create_texture_2d(TextureHandle handle,
-                                        const TextureInfo& info) {
+void RenderContextVk::create_texture(TextureHandle handle,
+                                     const TextureInfo& info) {
   // TODO: Defer to infer usage.
   VkImageUsageFlags image_usage_flags = 0;
   VkImageAspectFlags image_aspect_flags = 0;
@@ -1533,39 +4610,276 @@ void RenderContextVk::create_texture_2d(TextureHandle handle,
       VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
   image_aspect_flags |= VK_IMAGE_ASPECT_COLOR_BIT;
 
+  const VkExtent3D extent = {static_cast<uint32_t>(info.width),
+                             static_cast<uint32_t>(info.height),
+                             std::max<uint32_t>(info.depth, 1)};
+
+  // Cube maps store 6 faces per layer.
+  const uint32_t array_layers =
+      std::max<uint32_t>(info.num_layers, 1) * (info.cube_map ? 6 : 1);
+
+  if (info.streaming) {
+    assert(array_layers == 1 && extent.depth == 1 &&
+           "Only 2D textures can be streamed!");
+
+    StreamingTextureVk& stream = texture_streams[handle];
+    stream = {};
+    stream.extent = extent;
+    assert(info.num_mips <= k_max_texture_mips && "Too many mips!");
+    stream.num_mips = std::clamp<uint8_t>(info.num_mips, 1, k_max_texture_mips);
+
+    // Start with only the mips at or below the base size resident.
+    uint8_t min_resident_mip = 0;
+    while (min_resident_mip < stream.num_mips - 1 &&
+           std::max(extent.width, extent.height) >> min_resident_mip >
+               k_stream_base_size) {
+      min_resident_mip++;
+    }
+
+    stream.min_resident_mip = min_resident_mip;
+    stream.resident_mip = min_resident_mip;
+
+    texture_cache[handle].create(image_usage_flags,
+                                 mip_extent(extent, min_resident_mip),
+                                 VkFormat(info.format),
+                                 image_aspect_flags,
+                                 stream.num_mips - min_resident_mip);
+    set_defrag_owner(
+        texture_cache[handle].allocation, k_defrag_texture_owner, handle);
+
+    texture_resident_bytes += mip_chain_size(
+        extent, VkFormat(info.format), min_resident_mip, stream.num_mips);
+    streaming_textures[streaming_textures_count++] = handle;
+    bindless_dirty(handle);
+    return;
+  }
+
   texture_cache[handle].create(image_usage_flags,
-                               {static_cast<uint32_t>(info.width),
-                                static_cast<uint32_t>(info.height),
-                                1},
+                               extent,
                                VkFormat(info.format),
-                               image_aspect_flags);
+                               image_aspect_flags,
+                               1,
+                               array_layers,
+                               info.cube_map);
+  set_defrag_owner(
+      texture_cache[handle].allocation, k_defrag_texture_owner, handle);
+  bindless_dirty(handle);
 }
 
-void RenderContextVk::update_texture_2d(TextureHandle th,
-                                        uint32_t offset,
-                                        uint32_t size,
-                                        void* data) {
-  // TODO: Account for offset and size
-  dirty_textures[dirty_textures_head] = th;
-  ++dirty_textures_head;
+void RenderContextVk::update_texture(TextureHandle th,
+                                     uint32_t offset,
+                                     uint32_t size,
+                                     void* data) {
+  // Mip 0 of every layer, or the mip chain of streaming textures.
+  assert(offset == 0 && "Partial texture updates are not supported!");
+  assert(size >= (texture_streams[th].valid()
+                      ? mip_chain_size(texture_streams[th].extent,
+                                       texture_cache[th].format,
+                                       0,
+                                       texture_streams[th].num_mips)
+                      : mip_chain_size(texture_cache[th].extent,
+                                       texture_cache[th].format,
+                                       0,
+                                       1) *
+                            texture_cache[th].array_layers) &&
+         "Texture data is smaller than the texture!");
+
+  update_texture_layers(th, 0, UINT16_MAX, data);
+}
 
+void RenderContextVk::update_texture_layers(TextureHandle th,
+                                            uint16_t first_layer,
+                                            uint16_t num_layers,
+                                            void* data) {
   // TODO: Optional no keeping data ptr or copy.
   // Store data.
-  texture_data_ptrs[th] = data;
+  dirty_textures[dirty_textures_head] = {th, first_layer, num_layers, data};
+  ++dirty_textures_head;
 }
 
 void RenderContextVk::destroy(TextureHandle handle) {
-  texture_cache[handle].destroy();
+  StreamingTextureVk& stream = texture_streams[handle];
+  if (stream.valid()) {
+    texture_resident_bytes -= mip_chain_size(stream.extent,
+                                             texture_cache[handle].format,
+                                             stream.resident_mip,
+                                             stream.num_mips);
+
+    for (int i = 0; i < streaming_textures_count; i++) {
+      if (streaming_textures[i] == handle) {
+        streaming_textures[i] = streaming_textures[--streaming_textures_count];
+        break;
+      }
+    }
+
+    stream = {};
+  }
+
+  retire_descriptor_sets(handle, true);
+
+  retire(texture_cache[handle]);
+  texture_cache[handle] = {};
+}
+
+void RenderContextVk::request_texture_lod(TextureHandle th, float lod) {
+  StreamingTextureVk& stream = texture_streams[th];
+  if (!stream.valid()) {
+    return;
+  }
+
+  // Floored to the finer mip, a fractional lod samples both.
+  const float mip =
+      std::floor(std::clamp(lod, 0.0f, float(stream.num_mips - 1)));
+  stream.requested_mip =
+      std::min(stream.requested_mip, static_cast<uint8_t>(mip));
+  stream.last_used_frame = frame_number;
+}
+
+void RenderContextVk::request_texture_size(TextureHandle th,
+                                           float screen_size) {
+  const StreamingTextureVk& stream = texture_streams[th];
+  if (!stream.valid()) {
+    return;
+  }
+
+  const float size =
+      static_cast<float>(std::max(stream.extent.width, stream.extent.height));
+  const float lod = screen_size > 0.0f ? std::log2(size / screen_size)
+                                       : float(stream.num_mips - 1);
+
+  request_texture_lod(th, lod);
+}
+
+void RenderContextVk::set_texture_budget(uint64_t bytes) {
+  texture_budget = bytes;
+}
+
+TextureStreamingStats RenderContextVk::get_texture_streaming_stats() {
+  return texture_streaming_stats;
+}
+
+/// @returns Loaded shader of identical SPIR-V with a reference added, an
+/// invalid handle if none.
+static ShaderHandle acquire_shader(uint64_t content_key,
+                                   const void* spirv,
+                                   size_t n_bytes) {
+  auto [it, end] = shader_handles.equal_range(content_key);
+  for (; it != end; ++it) {
+    ShaderVk& shader = shader_cache[it->second];
+    if (memcmp(shader.spirv, spirv, n_bytes) == 0) {
+      shader.refs++;
+      return it->second;
+    }
+  }
+
+  return ShaderHandle{};
+}
+
+/// @brief Creates the shader of SPIR-V no loaded shader is identical to.
+///
+/// @param[in] owned_spirv SPIR-V read from a file, kept to compare, empty
+/// for packed shaders which compare in place.
+static void create_unique_shader(ShaderHandle handle,
+                                 const void* spirv,
+                                 std::vector<char> owned_spirv,
+                                 const ReflectionRecord& reflection) {
+  ShaderVk& shader = shader_cache[handle];
+  shader.create(spirv, reflection.spirv_size, reflection);
+  shader.content_key =
+      uint64_t(reflection.spirv_size) << 32 | reflection.spirv_hash;
+  shader.refs = 1;
+  shader.owned_spirv = std::move(owned_spirv);
+  shader.spirv = shader.owned_spirv.empty() ? spirv : shader.owned_spirv.data();
+  shader_handles.emplace(shader.content_key, handle);
 }
 
-void RenderContextVk::create_shader(ShaderHandle handle, const char* path) {
-  shader_cache[handle].create(path);
+ShaderHandle RenderContextVk::create_shader(ShaderHandle handle,
+                                           const char* path) {
+  assert(path != nullptr && "Passed invalid path!");
+
+  // The bindless set is shared, only program sets are reflected.
+  const uint32_t set = config.bindless ? k_bindless_program_set : 0;
+
+  // Packed shaders are created in place from the mapping, with the
+  // reflection of their entry.
+  const ShaderPackEntry* entry =
+      shader_pack.valid() ? shader_pack.find(path) : nullptr;
+  if (entry != nullptr && entry->reflection.set == set) {
+    const ReflectionRecord& reflection = entry->reflection;
+    const uint64_t content_key =
+        uint64_t(reflection.spirv_size) << 32 | reflection.spirv_hash;
+
+    const void* spirv = shader_pack.spirv(*entry);
+    ShaderHandle shader =
+        acquire_shader(content_key, spirv, reflection.spirv_size);
+    if (is_valid(shader)) {
+      return shader;
+    }
+
+    create_unique_shader(handle, spirv, {}, reflection);
+    return handle;
+  }
+
+  const size_t n_bytes = tsk::file_read(path, nullptr, 0);
+  std::vector<char> buffer(n_bytes);
+  if (n_bytes == 0 || !tsk::file_read(path, buffer.data(), buffer.size())) {
+    return handle;
+  }
+
+  uint32_t hash;
+  tsk::murmur_hash3_x86_32(buffer.data(), buffer.size(), 0, &hash);
+  const uint64_t content_key = uint64_t(buffer.size()) << 32 | hash;
+
+  ShaderHandle shader =
+      acquire_shader(content_key, buffer.data(), buffer.size());
+  if (is_valid(shader)) {
+    return shader;
+  }
+
+  // Records are read from next to the SPIR-V, or written there on first
+  // load.
+  const std::string reflection_path = std::string(path) + ".refl";
+
+  ReflectionRecord reflection;
+  if (!read_reflection(
+          reflection_path.c_str(), buffer.size(), hash, set, &reflection)) {
+    if (!reflect_spirv(buffer.data(), buffer.size(), hash, set, &reflection)) {
+      assert(false && "[TSKGFX]: Failed to reflect shader!");
+      return handle;
+    }
+
+    // Read-only shader directories reflect on every load.
+    write_reflection(reflection_path.c_str(), reflection);
+  }
+
+  const void* spirv = buffer.data();
+  create_unique_shader(handle, spirv, std::move(buffer), reflection);
+  return handle;
 }
 
 void RenderContextVk::destroy(ShaderHandle sh) {
-  assert(shader_cache[sh].valid());
+  ShaderVk& shader = shader_cache[sh];
+  assert(shader.valid());
+
+  if (--shader.refs > 0) {
+    return;
+  }
+  auto [it, end] = shader_handles.equal_range(shader.content_key);
+  for (; it != end; ++it) {
+    if (it->second.idx == sh.idx) {
+      shader_handles.erase(it);
+      break;
+    }
+  }
+
+  // Programs compile pipelines from the module on first use of a state, it is
+  // destroyed once released by them.
+  if (shader_module_refs.count(shader.module) > 0) {
+    retired_shader_modules.push_back(shader.module);
+    shader.module = VK_NULL_HANDLE;
+  }
 
-  shader_cache[sh].destroy();
+  shader.destroy();
 }
 
 void RenderContextVk::create_program(ProgramHandle handle,
@@ -1576,6 +4890,7 @@ void RenderContextVk::create_program(ProgramHandle handle,
   const ShaderVk& fs = shader_cache[fsh];
 
   program_cache[handle].create(vs, fs);
+  request_recorded_pipelines(handle);
 }
 
 void RenderContextVk::create_program(ProgramHandle ph, ShaderHandle csh) {
@@ -1583,31 +4898,183 @@ void RenderContextVk::create_program(ProgramHandle ph, ShaderHandle csh) {
   program_cache[ph].create(cs);
 }
 
+/// @brief Destroys the pipelines of a variant, its program owns the rest.
+static void destroy_variant(ProgramVk& variant) {
+  for (auto& [key, job] : pending_pipelines) {
+    if (key.layout == variant.pipeline_layout &&
+        key.constants == variant.constants_hash) {
+      job->cancelled = true;
+    }
+  }
+
+  const bool compiling = compiling_layout(variant.pipeline_layout);
+  for (auto it = pipeline_cache.begin(); it != pipeline_cache.end();) {
+    if (it->first.layout != variant.pipeline_layout ||
+        it->first.constants != variant.constants_hash) {
+      ++it;
+      continue;
+    }
+
+    retire_pipeline(it->first, it->second, compiling);
+    it = pipeline_cache.erase(it);
+  }
+
+  for (VkShaderModule module :
+       {variant.vs_module, variant.fs_module, variant.cs_module}) {
+    release_shader_module(module);
+  }
+
+  program_variants.erase(uint64_t(variant.base.idx) << 32 |
+                         variant.constants_hash);
+  variant = {};
+}
+
 void RenderContextVk::destroy(ProgramHandle ph) {
-  assert(program_cache[ph].valid() && "Attemping to destroy invalid program!");
-  program_cache[ph].destroy();
+  ProgramVk& program = program_cache[ph];
+  assert(program.valid() && "Attemping to destroy invalid program!");
+
+  if (is_valid(program.base)) {
+    destroy_variant(program);
+    cancel_warmup();
+    return;
+  }
+
+  // Pipelines of the variants are retired with the program's below.
+  for (auto it = program_variants.begin(); it != program_variants.end();) {
+    if (it->first >> 32 != ph.idx) {
+      ++it;
+      continue;
+    }
+
+    ProgramVk& variant = program_cache[it->second];
+    for (VkShaderModule module :
+         {variant.vs_module, variant.fs_module, variant.cs_module}) {
+      release_shader_module(module);
+    }
+
+    variant = {};
+    it = program_variants.erase(it);
+  }
+
+  DeletionQueueVk& queue = deletion_queue();
+
+  // The pipeline layout is used until compiled, collect_pipelines retires it
+  // with the last pipeline.
+  bool compiling = false;
+  for (auto& [key, job] : pending_pipelines) {
+    if (key.layout == program.pipeline_layout) {
+      job->cancelled = true;
+      compiling = true;
+    }
+  }
+
+  if (compiling) {
+    retired_pipeline_layouts.push_back(program.pipeline_layout);
+  } else {
+    queue.pipeline_layouts.push_back(program.pipeline_layout);
+  }
+
+  // Pipelines and libraries of every state and variant.
+  for (auto it = pipeline_cache.begin(); it != pipeline_cache.end();) {
+    if (it->first.layout != program.pipeline_layout) {
+      ++it;
+      continue;
+    }
+
+    retire_pipeline(it->first, it->second, compiling);
+    it = pipeline_cache.erase(it);
+  }
+
+  // Sets of the layout, its handle may be reused once destroyed.
+  for (auto it = ds_set_cache.begin(); it != ds_set_cache.end();) {
+    if (it->first.layout != program.descriptor_set_layout) {
+      ++it;
+      continue;
+    }
+
+    queue.descriptor_sets.push_back(it->second.allocation);
+    it = ds_set_cache.erase(it);
+  }
+
+  for (VkShaderModule module :
+       {program.vs_module, program.fs_module, program.cs_module}) {
+    release_shader_module(module);
+  }
+
+  queue.descriptor_set_layouts.push_back(program.descriptor_set_layout);
+  if (program.update_template != VK_NULL_HANDLE) {
+    queue.update_templates.push_back(program.update_template);
+    push_descriptor_programs--;
+  }
+
+  // Largest set counts are kept, sets of the program may still be in use.
+  if (program.pooled) {
+    for (uint32_t t = 0; t < k_descriptor_type_count; t++) {
+      pool_descriptor_totals[t] -= program.pool_descriptors[t];
+    }
+    pool_programs--;
+  }
+  program = {};
+  cancel_warmup();
 }
 
 void RenderContextVk::create_descriptor(DescriptorHandle handle,
                                         DescriptorType type,
                                         uint16_t rh,
+                                        const SamplerInfo& sampler,
                                         const char* name) {
   assert(!descriptor_set_info_cache[handle].valid() &&
          "Attemping to override descriptor.");
 
   descriptor_set_info_cache[handle].type = type;
   descriptor_set_info_cache[handle].resource_handle_index = rh;
+  descriptor_set_info_cache[handle].sampler = sampler;
 
   strcpy_s(descriptor_set_info_cache[handle].name, name);
+
+  // Label the bound resource with the descriptor name for attribution.
+  if (rh == k_invalid_handle) {
+    return;
+  }
+
+  switch (type) {
+    case DescriptorType::k_uniform_buffer:
+    case DescriptorType::k_storage_buffer:
+    case DescriptorType::k_uniform_buffer_dynamic:
+    case DescriptorType::k_storage_buffer_dynamic: {
+      BufferVk& buffer = buffer_cache[rh];
+      if (buffer.valid() && buffer.name() == nullptr) {
+        buffer.set_name(name);
+      }
+    } break;
+
+    case DescriptorType::k_combined_image_sampler:
+    case DescriptorType::k_sampled_image:
+    case DescriptorType::k_storage_image: {
+      TextureVk& texture = texture_cache[rh];
+      if (texture.valid() && texture.name() == nullptr) {
+        texture.set_name(name);
+      }
+    } break;
+
+    default:
+      break;
+  }
 };
 
 void RenderContextVk::create_uniform_buffer(BufferHandle bh,
                                             uint32_t size,
                                             void* data) {
-  buffer_cache[bh].create(
-      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      size,
-      true);
+  // Every buffer is readable from the bindless buffer array.
+  buffer_cache[bh].create(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                              bindless_buffer_usage(),
+                          size,
+                          true);
+  set_defrag_owner(
+      buffer_cache[bh].vma_allocation(), k_defrag_buffer_owner, bh);
+  bindless_dirty(bh);
 }
 
 void RenderContextVk::create_vertex_buffer(BufferHandle bh,
@@ -1618,14 +5085,21 @@ void RenderContextVk::create_vertex_buffer(BufferHandle bh,
                               VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                               VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
                           size);
+  set_defrag_owner(
+      buffer_cache[bh].vma_allocation(), k_defrag_buffer_owner, bh);
+  bindless_dirty(bh);
 };
 
 void RenderContextVk::create_index_buffer(BufferHandle bh,
                                           uint32_t size,
                                           void* data) {
-  buffer_cache[bh].create(
-      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      size);
+  buffer_cache[bh].create(VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                              bindless_buffer_usage(),
+                          size);
+  set_defrag_owner(
+      buffer_cache[bh].vma_allocation(), k_defrag_buffer_owner, bh);
+  bindless_dirty(bh);
 }
 
 void RenderContextVk::update_buffer(BufferHandle handle,
@@ -1643,7 +5117,399 @@ void RenderContextVk::update_buffer(BufferHandle handle,
 
 void RenderContextVk::destroy(BufferHandle bh) {
   assert(buffer_cache[bh].valid() && "Cannot destroy invalid buffer!");
-  buffer_cache[bh].destroy();
+
+  retire_descriptor_sets(bh, false);
+
+  retire(buffer_cache[bh]);
+  buffer_cache[bh] = {};
+}
+
+void RenderContextVk::destroy(DescriptorHandle dh) {
+  retire_descriptor_sets(dh);
+
+  descriptor_set_info_cache[dh] = {};
+}
+
+uint32_t RenderContextVk::get_bindless_sampler(const SamplerInfo& sampler) {
+  return get_sampler(sampler).bindless_index;
+}
+
+/// @brief Creates an arena to sub-allocate meshes from.
+static MeshArenaVk& create_mesh_arena() {
+  assert(mesh_arena_count < k_max_mesh_arenas && "Exceeded mesh arenas!");
+  MeshArenaVk& arena = mesh_arenas[mesh_arena_count++];
+
+  arena.vertices.create(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                        k_mesh_vertex_arena_size);
+  arena.vertices.set_name("mesh_vertex_arena");
+  arena.vertex_allocator.init(k_mesh_vertex_arena_size);
+
+  arena.indices.create(
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      k_mesh_index_arena_size);
+  arena.indices.set_name("mesh_index_arena");
+  arena.index_allocator.init(k_mesh_index_arena_size);
+
+  return arena;
+}
+
+void MeshVk::destroy() {
+  MeshArenaVk& arena = mesh_arenas[this->arena];
+  arena.vertex_allocator.free(vertices);
+  arena.index_allocator.free(indices);
+
+  vertices = {};
+  indices = {};
+}
+
+bool RenderContextVk::create_mesh(MeshHandle mh,
+                                  const void* vertices,
+                                  uint32_t vertices_size,
+                                  const uint32_t* indices,
+                                  uint32_t index_count) {
+  MeshVk& mesh = mesh_cache[mh];
+  assert(!mesh.valid() && "Mesh already initialized!");
+
+  // Keep vertex ranges aligned for the vertex address.
+  const VkDeviceSize vertex_size =
+      (vertices_size + k_mesh_vertex_alignment - 1) &
+      ~(k_mesh_vertex_alignment - 1);
+  const VkDeviceSize index_size = index_count * sizeof(uint32_t);
+  if (vertex_size > k_mesh_vertex_arena_size ||
+      index_size > k_mesh_index_arena_size) {
+    return false;
+  }
+
+  for (int i = 0; i <= mesh_arena_count; i++) {
+    // No arena has room and no more can be created.
+    if (i == k_max_mesh_arenas) {
+      return false;
+    }
+
+    MeshArenaVk& arena =
+        i < mesh_arena_count ? mesh_arenas[i] : create_mesh_arena();
+
+    mesh.vertices = arena.vertex_allocator.allocate(vertex_size);
+    if (!mesh.vertices.valid()) {
+      continue;
+    }
+
+    mesh.indices = arena.index_allocator.allocate(index_size);
+    if (!mesh.indices.valid()) {
+      arena.vertex_allocator.free(mesh.vertices);
+      mesh.vertices = {};
+      continue;
+    }
+
+    mesh.arena = i;
+    break;
+  }
+
+  mesh.index_count = index_count;
+  dirty_meshes[dirty_meshes_head] = {mh, vertices, vertices_size, indices};
+  ++dirty_meshes_head;
+  return true;
+}
+
+void RenderContextVk::destroy(MeshHandle mh) {
+  MeshVk& mesh = mesh_cache[mh];
+  assert(mesh.valid() && "Cannot destroy invalid mesh!");
+
+  deletion_queue().meshes.push_back(mesh);
+  mesh = {};
+}
+
+void RenderContextVk::set_name(BufferHandle bh, const char* name) {
+  assert(buffer_cache[bh].valid() && "Cannot name invalid buffer!");
+  buffer_cache[bh].set_name(name);
+}
+
+void RenderContextVk::set_name(TextureHandle th, const char* name) {
+  assert(texture_cache[th].valid() && "Cannot name invalid texture!");
+  texture_cache[th].set_name(name);
+}
+
+MemoryStats RenderContextVk::get_memory_stats() {
+  MemoryStats stats = {};
+
+  const VkPhysicalDeviceMemoryProperties* memory_properties = nullptr;
+  vmaGetMemoryProperties(allocator, &memory_properties);
+
+  VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+  vmaGetHeapBudgets(allocator, budgets);
+
+  stats.heap_count =
+      std::min(memory_properties->memoryHeapCount, k_max_memory_heaps);
+  for (uint32_t heap = 0; heap < stats.heap_count; heap++) {
+    stats.heaps[heap].budget = budgets[heap].budget;
+    stats.heaps[heap].usage = budgets[heap].usage;
+    stats.heaps[heap].device_local =
+        (memory_properties->memoryHeaps[heap].flags &
+         VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+  }
+
+  for (uint32_t i = 0; i < uint32_t(MemoryCategory::k_count); i++) {
+    stats.category_bytes[i] = memory_category_bytes[i];
+  }
+
+  return stats;
+}
+
+uint32_t RenderContextVk::get_resource_memory(ResourceMemoryInfo* infos,
+                                              uint32_t max_infos) {
+  uint32_t count = 0;
+
+  auto add = [&](const char* name, MemoryCategory category, uint64_t size) {
+    if (infos != nullptr && count < max_infos) {
+      infos[count] = {name != nullptr ? name : "", category, size};
+    }
+    count++;
+  };
+
+  for (const BufferVk& buffer : buffer_cache) {
+    if (buffer.valid()) {
+      add(buffer.name(), buffer.category, buffer.allocated_size());
+    }
+  }
+
+  // Released resources hold their memory until their frame retires.
+  for (const DeletionQueueVk& queue : deletion_queues) {
+    for (const BufferVk& buffer : queue.buffers) {
+      add(buffer.name(), buffer.category, buffer.allocated_size());
+    }
+
+    for (const TextureVk& texture : queue.textures) {
+      add(texture.name(), texture.category, texture.allocation->GetSize());
+    }
+  }
+
+  for (int i = 0; i < mesh_arena_count; i++) {
+    for (const BufferVk* buffer :
+         {&mesh_arenas[i].vertices, &mesh_arenas[i].indices}) {
+      add(buffer->name(), buffer->category, buffer->allocated_size());
+    }
+  }
+
+  for (const TextureVk& texture : texture_cache) {
+    if (texture.valid()) {
+      add(texture.name(), texture.category, texture.allocation->GetSize());
+    }
+  }
+
+  for (const TextureVk* texture : {&final_color_texture, &final_depth_texture}) {
+    add(texture->name(), texture->category, texture->allocation->GetSize());
+  }
+
+  return count;
+}
+
+void RenderContextVk::set_memory_warning_callback(MemoryWarningFn fn,
+                                                  float threshold) {
+  memory_warning_fn = fn;
+  memory_warning_threshold = threshold;
+  memory_warning_heaps = 0;
+}
+
+void RenderContextVk::defragment(uint64_t max_bytes_per_frame,
+                                 uint32_t max_moves_per_frame,
+                                 float max_ms_per_frame) {
+  if (defrag_context != VK_NULL_HANDLE) {
+    return;
+  }
+
+  defrag_max_ms = max_ms_per_frame;
+
+  VmaDefragmentationInfo defrag_info = {};
+  defrag_info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+  defrag_info.maxBytesPerPass = max_bytes_per_frame;
+  defrag_info.maxAllocationsPerPass = max_moves_per_frame;
+  defrag_info.pfnBreakCallback = max_ms_per_frame > 0.0f ? defrag_break : nullptr;
+  VK_CHECK(vmaBeginDefragmentation(allocator, &defrag_info, &defrag_context));
+
+  defrag_stats = {};
+  defrag_stats.fragmentation_before = fragmentation_percent();
+  defrag_stats.running = true;
+}
+
+DefragmentationStats RenderContextVk::get_defragmentation_stats() {
+  return defrag_stats;
+}
+
+bool RenderContextVk::is_ready(ProgramHandle ph) {
+  collect_pipelines();
+
+  // Links the pipeline once its libraries compiled.
+  return request_pipeline(program_cache[ph],
+                          pack_render_state(RenderState{})) != VK_NULL_HANDLE;
+}
+
+void RenderContextVk::set_fallback_program(ProgramHandle ph) {
+  fallback_ph = ph;
+}
+
+ProgramHandle RenderContextVk::create_program_variant(
+    ProgramHandle variant,
+    ProgramHandle ph,
+    const SpecializationConstant* constants,
+    uint32_t count) {
+  const ProgramVk& program = program_cache[ph];
+  assert(program.valid() && !is_valid(program.base) &&
+         "Variants are created from valid programs!");
+
+  // Constants the program declares, sorted by id so the order they are passed
+  // in does not change the hash. Later values of an id win.
+  SpecializationConstant sorted[k_max_specialization_constants];
+  uint32_t n_sorted = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const uint32_t* ids_end = program.constant_ids + program.n_constant_ids;
+    if (std::find(program.constant_ids, ids_end, constants[i].id) ==
+        ids_end) {
+      continue;
+    }
+
+    SpecializationConstant* end = sorted + n_sorted;
+    SpecializationConstant* it =
+        std::find_if(sorted, end, [&](const SpecializationConstant& c) {
+          return c.id == constants[i].id;
+        });
+    if (it != end) {
+      it->value = constants[i].value;
+    } else {
+      sorted[n_sorted++] = constants[i];
+    }
+  }
+
+  if (n_sorted == 0) {
+    return ph;
+  }
+
+  std::sort(sorted,
+            sorted + n_sorted,
+            [](const SpecializationConstant& a,
+               const SpecializationConstant& b) { return a.id < b.id; });
+
+  uint32_t hash;
+  tsk::murmur_hash3_x86_32(
+      sorted, n_sorted * sizeof(SpecializationConstant), 0, &hash);
+  hash = hash != 0 ? hash : 1;  // 0 keys the pipelines of the program.
+
+  // Variants of colliding constants take the next free hash, so they and
+  // their pipelines are keyed apart.
+  uint64_t key = uint64_t(ph.idx) << 32 | hash;
+  for (auto it = program_variants.find(key); it != program_variants.end();
+       it = program_variants.find(key)) {
+    const ProgramVk& existing = program_cache[it->second];
+    if (existing.n_constants == n_sorted &&
+        memcmp(existing.constants,
+               sorted,
+               n_sorted * sizeof(SpecializationConstant)) == 0) {
+      return it->second;
+    }
+
+    hash = hash + 1 != 0 ? hash + 1 : 1;
+    key = uint64_t(ph.idx) << 32 | hash;
+  }
+
+  ProgramVk& program_variant = program_cache[variant];
+  assert(!program_variant.valid() && "Program already intialized!");
+
+  program_variant = program;
+  program_variant.base = ph;
+  program_variant.constants_hash = hash;
+  program_variant.n_constants = n_sorted;
+  memcpy(program_variant.constants,
+         sorted,
+         n_sorted * sizeof(SpecializationConstant));
+
+  for (VkShaderModule module : {program_variant.vs_module,
+                                program_variant.fs_module,
+                                program_variant.cs_module}) {
+    acquire_shader_module(module);
+  }
+
+  // Compiled like the program, see is_ready.
+  request_pipeline(program_variant,
+                   program_variant.cs_module != VK_NULL_HANDLE
+                       ? 0
+                       : pack_render_state(RenderState{}));
+
+  program_variants[key] = variant;
+  request_recorded_pipelines(variant);
+  return variant;
+}
+
+uint32_t RenderContextVk::get_specialization_constants(ProgramHandle ph,
+                                                       uint32_t* ids) {
+  const ProgramVk& program = program_cache[ph];
+
+  if (ids != nullptr) {
+    memcpy(ids,
+           program.constant_ids,
+           program.n_constant_ids * sizeof(uint32_t));
+  }
+
+  return program.n_constant_ids;
+}
+
+bool RenderContextVk::save_pipeline_cache() {
+  if (pipeline_cache_path.empty() || device_pipeline_cache == VK_NULL_HANDLE) {
+    return false;
+  }
+
+  size_t data_size = 0;
+  VK_CHECK(vkGetPipelineCacheData(
+      device, device_pipeline_cache, &data_size, nullptr));
+
+  std::vector<char> buffer(sizeof(PipelineCacheHeaderVk) + data_size);
+  char* data = buffer.data() + sizeof(PipelineCacheHeaderVk);
+  VK_CHECK(vkGetPipelineCacheData(
+      device, device_pipeline_cache, &data_size, data));
+
+  PipelineCacheHeaderVk header = pipeline_cache_header;
+  header.data_size = data_size;
+  tsk::murmur_hash3_x86_32(data, data_size, 0, &header.data_hash);
+  memcpy(buffer.data(), &header, sizeof(header));
+
+  // Written next to the cache and renamed over it, so a crash while writing
+  // leaves the previous cache intact.
+  const std::string temp_path = pipeline_cache_path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+
+  const bool written =
+      fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() &&
+      fflush(file) == 0;
+  fclose(file);
+
+  std::error_code error;
+  if (written) {
+    std::filesystem::rename(temp_path, pipeline_cache_path, error);
+  }
+
+  if (!written || error) {
+    std::filesystem::remove(temp_path, error);
+    return false;
+  }
+
+  pipeline_cache_stats.saved_bytes = data_size;
+  return true;
+}
+
+PipelineCacheStats RenderContextVk::get_pipeline_cache_stats() {
+  return pipeline_cache_stats;
+}
+
+DescriptorCacheStats RenderContextVk::get_descriptor_cache_stats() {
+  DescriptorCacheStats stats = descriptor_cache_stats;
+  stats.cached_sets = static_cast<uint32_t>(ds_set_cache.size());
+  stats.pools = static_cast<uint32_t>(descriptor_pools.size());
+  stats.descriptor_buffer = descriptor_buffer_enabled;
+  stats.push_descriptor_programs = push_descriptor_programs;
+  return stats;
 }
 
 void RenderContextVk::submit(Frame* frame) {
@@ -0,0 +1,245 @@
+#include "tskgfx/shader_pack.h"
+
+#include <tsk/file.h>
+#include <tsk/murmur_hash_3.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef TUSK_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tsk {
+
+static uint32_t name_hash(const char* name) {
+  uint32_t hash;
+  tsk::murmur_hash3_x86_32(name, strlen(name), 0, &hash);
+  return hash;
+}
+
+bool ShaderPack::open(const char* path) {
+  assert(!valid() && "Shader pack already open!");
+
+#ifdef TUSK_WIN32
+  file = CreateFileA(path,
+                     GENERIC_READ,
+                     FILE_SHARE_READ,
+                     nullptr,
+                     OPEN_EXISTING,
+                     FILE_ATTRIBUTE_NORMAL,
+                     nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    file = nullptr;
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  mapping = GetFileSizeEx(file, &file_size)
+                ? CreateFileMappingA(
+                      file, nullptr, PAGE_READONLY, 0, 0, nullptr)
+                : nullptr;
+  if (mapping != nullptr) {
+    data = static_cast<const uint8_t*>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    size = static_cast<size_t>(file_size.QuadPart);
+  }
+#else
+  const int fd = ::open(path, O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+
+  // The mapping outlives the descriptor.
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    void* mapped = mmap(nullptr,
+                        static_cast<size_t>(file_stat.st_size),
+                        PROT_READ,
+                        MAP_PRIVATE,
+                        fd,
+                        0);
+    if (mapped != MAP_FAILED) {
+      data = static_cast<const uint8_t*>(mapped);
+      size = static_cast<size_t>(file_stat.st_size);
+    }
+  }
+  ::close(fd);
+#endif
+
+  if (data == nullptr) {
+    close();
+    return false;
+  }
+
+  // Entries are validated once, lookups trust them.
+  const ShaderPackHeader* header =
+      reinterpret_cast<const ShaderPackHeader*>(data);
+  bool valid_pack = size >= sizeof(ShaderPackHeader) &&
+                    header->magic == k_shader_pack_magic &&
+                    header->version == k_shader_pack_version &&
+                    header->n_entries <= (size - sizeof(ShaderPackHeader)) /
+                                             sizeof(ShaderPackEntry);
+
+  for (uint32_t i = 0; valid_pack && i < header->n_entries; i++) {
+    const ShaderPackEntry& entry = entries()[i];
+    // Shaders are created from the counts and words of entries unchecked.
+    valid_pack = entry.offset % sizeof(uint32_t) == 0 &&
+                 entry.offset <= size &&
+                 entry.reflection.spirv_size <= size - entry.offset &&
+                 valid_reflection(entry.reflection) &&
+                 memchr(entry.name, '\0', k_max_shader_pack_name) != nullptr;
+  }
+
+  if (!valid_pack) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void ShaderPack::close() {
+#ifdef TUSK_WIN32
+  if (data != nullptr) {
+    UnmapViewOfFile(data);
+  }
+  if (mapping != nullptr) {
+    CloseHandle(mapping);
+  }
+  if (file != nullptr) {
+    CloseHandle(file);
+  }
+  mapping = nullptr;
+  file = nullptr;
+#else
+  if (data != nullptr) {
+    munmap(const_cast<uint8_t*>(data), size);
+  }
+#endif
+
+  data = nullptr;
+  size = 0;
+}
+
+const ShaderPackEntry* ShaderPack::find(const char* name) const {
+  const ShaderPackEntry* begin = entries();
+  const ShaderPackEntry* end = begin + count();
+  const uint32_t hash = name_hash(name);
+
+  // Entries are sorted by name hash, names disambiguate collisions.
+  const ShaderPackEntry* it = std::lower_bound(
+      begin, end, hash, [](const ShaderPackEntry& entry, uint32_t hash) {
+        return entry.name_hash < hash;
+      });
+  for (; it != end && it->name_hash == hash; ++it) {
+    if (strcmp(it->name, name) == 0) {
+      return it;
+    }
+  }
+
+  return nullptr;
+}
+
+const ShaderPackEntry* ShaderPack::find(uint32_t spirv_hash) const {
+  const ShaderPackEntry* begin = entries();
+  const ShaderPackEntry* end = begin + count();
+
+  const ShaderPackEntry* it =
+      std::find_if(begin, end, [spirv_hash](const ShaderPackEntry& entry) {
+        return entry.reflection.spirv_hash == spirv_hash;
+      });
+
+  return it != end ? it : nullptr;
+}
+
+bool write_shader_pack(const char* path,
+                       const char* const* spirv_paths,
+                       uint32_t count,
+                       uint32_t set) {
+  std::vector<ShaderPackEntry> entries(count);
+  std::vector<std::vector<char>> blobs(count);
+
+  uint64_t offset =
+      sizeof(ShaderPackHeader) + uint64_t(count) * sizeof(ShaderPackEntry);
+  for (uint32_t i = 0; i < count; i++) {
+    const size_t n_bytes = tsk::file_read(spirv_paths[i], nullptr, 0);
+    if (n_bytes == 0 || strlen(spirv_paths[i]) >= k_max_shader_pack_name) {
+      return false;
+    }
+
+    std::vector<char>& blob = blobs[i];
+    blob.resize(n_bytes);
+    if (!tsk::file_read(spirv_paths[i], blob.data(), blob.size())) {
+      return false;
+    }
+
+    ShaderPackEntry& entry = entries[i];
+    memset(&entry, 0, sizeof(entry));
+    entry.name_hash = name_hash(spirv_paths[i]);
+    strncpy(entry.name, spirv_paths[i], k_max_shader_pack_name - 1);
+
+    uint32_t spirv_hash;
+    tsk::murmur_hash3_x86_32(blob.data(), blob.size(), 0, &spirv_hash);
+    if (!reflect_spirv(
+            blob.data(), blob.size(), spirv_hash, set, &entry.reflection)) {
+      return false;
+    }
+
+    // SPIR-V is read as words, blobs stay 4 byte aligned.
+    entry.offset = offset;
+    offset += (blob.size() + 3) & ~size_t(3);
+  }
+
+  std::vector<uint32_t> order(count);
+  for (uint32_t i = 0; i < count; i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&entries](uint32_t a, uint32_t b) {
+    return entries[a].name_hash < entries[b].name_hash;
+  });
+
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+
+  ShaderPackHeader header = {};
+  header.magic = k_shader_pack_magic;
+  header.version = k_shader_pack_version;
+  header.n_entries = count;
+
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (uint32_t i : order) {
+    written = written && fwrite(&entries[i], sizeof(ShaderPackEntry), 1, file);
+  }
+
+  const uint32_t zero = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const size_t padding = ((blobs[i].size() + 3) & ~size_t(3)) -
+                           blobs[i].size();
+    written = written &&
+              fwrite(blobs[i].data(), 1, blobs[i].size(), file) ==
+                  blobs[i].size() &&
+              fwrite(&zero, 1, padding, file) == padding;
+  }
+
+  written = written && fflush(file) == 0;
+  fclose(file);
+
+  if (!written) {
+    remove(path);
+  }
+
+  return written;
+}
+
+}  // namespace tsk
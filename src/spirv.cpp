@@ -5,6 +5,8 @@
 #include <vulkan/vulkan_core.h>
 
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <unordered_map>
 
 #include "spirv_reflect/include/spirv/unified1/spirv.h"
@@ -123,7 +125,8 @@ bool parse_spirv(const void* spirv_code,
                  VkDescriptorSetLayoutBinding* bindings,
                  uint32_t* n_bindings,
                  VkPushConstantRange* pc_ranges,
-                 uint32_t* n_pc_ranges) {
+                 uint32_t* n_pc_ranges,
+                 uint32_t set) {
   // spdlog::set_level(spdlog::level::trace);
 
   SpvReflectShaderModule module;
@@ -135,7 +138,10 @@ bool parse_spirv(const void* spirv_code,
     return false;
   }
 
-  {
+  // Type names are only built for trace output.
+  const bool trace = spdlog::should_log(spdlog::level::trace);
+
+  if (trace) {
     uint32_t var_count = 0;
     result = spvReflectEnumerateInterfaceVariables(&module, &var_count, NULL);
     assert(result == SPV_REFLECT_RESULT_SUCCESS);
@@ -182,17 +188,27 @@ bool parse_spirv(const void* spirv_code,
 
   {
     assert(n_bindings != nullptr && "Must pass non null n_bindings!");
-    result = spvReflectEnumerateDescriptorBindings(&module, n_bindings, NULL);
+    uint32_t n_all_bindings = 0;
+    result =
+        spvReflectEnumerateDescriptorBindings(&module, &n_all_bindings, NULL);
     assert(result == SPV_REFLECT_RESULT_SUCCESS);
 
-    if (bindings != nullptr) {
-      SpvReflectDescriptorBinding** ds_bindings =
-          (SpvReflectDescriptorBinding**)malloc(
-              *n_bindings * sizeof(SpvReflectDescriptorBinding*));
-      result = spvReflectEnumerateDescriptorBindings(&module, n_bindings,
-                                                     ds_bindings);
-      assert(result == SPV_REFLECT_RESULT_SUCCESS);
+    SpvReflectDescriptorBinding** ds_bindings =
+        (SpvReflectDescriptorBinding**)malloc(
+            n_all_bindings * sizeof(SpvReflectDescriptorBinding*));
+    result = spvReflectEnumerateDescriptorBindings(&module, &n_all_bindings,
+                                                   ds_bindings);
+    assert(result == SPV_REFLECT_RESULT_SUCCESS);
 
+    // Keep the bindings of the requested set.
+    *n_bindings = 0;
+    for (uint32_t i = 0; i < n_all_bindings; i++) {
+      if (set == k_spirv_any_set || ds_bindings[i]->set == set) {
+        ds_bindings[(*n_bindings)++] = ds_bindings[i];
+      }
+    }
+
+    if (bindings != nullptr) {
       for (uint32_t i = 0; i < *n_bindings; i++) {
         const SpvReflectDescriptorBinding& ds_binding = *ds_bindings[i];
         VkDescriptorType ds_type =
@@ -202,6 +218,10 @@ bool parse_spirv(const void* spirv_code,
         bindings[i].descriptorCount = ds_binding.count;
         bindings[i].descriptorType = ds_type;
 
+        if (!trace) {
+          continue;
+        }
+
         spdlog::trace("ds({}) binding({}) type({})", ds_binding.set,
                       ds_binding.binding, k_ds_type_to_string[ds_type]);
         const SpvReflectTypeDescription& ds_type_desc =
@@ -234,9 +254,9 @@ bool parse_spirv(const void* spirv_code,
           } break;
         }
       }
-
-      free(ds_bindings);
     }
+
+    free(ds_bindings);
   }
 
   {
@@ -256,6 +276,10 @@ bool parse_spirv(const void* spirv_code,
         pc_ranges[i].size = bv.size;
         pc_ranges[i].offset = bv.offset;
 
+        if (!trace) {
+          continue;
+        }
+
         spdlog::trace(bv.type_description->type_name);
         for (uint32_t i = 0; i < bv.member_count; i++) {
           SpvReflectBlockVariable bm = bv.members[i];
@@ -271,4 +295,192 @@ bool parse_spirv(const void* spirv_code,
   return true;
 }
 
+bool parse_spirv_constants(const void* spirv_code,
+                           size_t spirv_nbytes,
+                           uint32_t* constant_ids,
+                           uint32_t* n_constants) {
+  assert(n_constants != nullptr && "Must pass non null n_constants!");
+
+  SpvReflectShaderModule module;
+  SpvReflectResult result =
+      spvReflectCreateShaderModule(spirv_nbytes, spirv_code, &module);
+  assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+  if (result != SPV_REFLECT_RESULT_SUCCESS) {
+    return false;
+  }
+
+  result =
+      spvReflectEnumerateSpecializationConstants(&module, n_constants, NULL);
+  assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+  if (constant_ids != nullptr && *n_constants > 0) {
+    SpvReflectSpecializationConstant** constants =
+        (SpvReflectSpecializationConstant**)malloc(
+            *n_constants * sizeof(SpvReflectSpecializationConstant*));
+    result = spvReflectEnumerateSpecializationConstants(
+        &module, n_constants, constants);
+    assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+    for (uint32_t i = 0; i < *n_constants; i++) {
+      constant_ids[i] = constants[i]->constant_id;
+      spdlog::trace("constant_id({}) {}", constants[i]->constant_id,
+                    constants[i]->name ? constants[i]->name : "");
+    }
+
+    free(constants);
+  }
+
+  spvReflectDestroyShaderModule(&module);
+  return true;
+}
+
+/// @brief Reflects the located input and output variables of a shader.
+static bool parse_spirv_variables(const void* spirv_code,
+                                  size_t spirv_nbytes,
+                                  ReflectedVariable* variables,
+                                  uint32_t* n_variables) {
+  SpvReflectShaderModule module;
+  SpvReflectResult result =
+      spvReflectCreateShaderModule(spirv_nbytes, spirv_code, &module);
+  assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+  if (result != SPV_REFLECT_RESULT_SUCCESS) {
+    return false;
+  }
+
+  uint32_t var_count = 0;
+  result = spvReflectEnumerateInterfaceVariables(&module, &var_count, NULL);
+  assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+  SpvReflectInterfaceVariable** interface_variables =
+      (SpvReflectInterfaceVariable**)malloc(
+          var_count * sizeof(SpvReflectInterfaceVariable*));
+  result = spvReflectEnumerateInterfaceVariables(
+      &module, &var_count, interface_variables);
+  assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+  // Built-ins have no location.
+  *n_variables = 0;
+  for (uint32_t i = 0; i < var_count; i++) {
+    const SpvReflectInterfaceVariable& iv = *interface_variables[i];
+    if ((iv.decoration_flags & SPV_REFLECT_DECORATION_BUILT_IN) != 0 ||
+        *n_variables == k_max_reflected_variables) {
+      continue;
+    }
+
+    ReflectedVariable& variable = variables[(*n_variables)++];
+    variable = {};
+    variable.location = iv.location;
+    variable.format = iv.format;
+    variable.output = iv.storage_class == SpvStorageClassOutput ? 1 : 0;
+  }
+
+  free(interface_variables);
+  spvReflectDestroyShaderModule(&module);
+  return true;
+}
+
+bool reflect_spirv(const void* spirv_code,
+                   size_t spirv_nbytes,
+                   uint32_t spirv_hash,
+                   uint32_t set,
+                   ReflectionRecord* record) {
+  assert(record != nullptr && "Must pass non null record!");
+
+  memset(record, 0, sizeof(ReflectionRecord));
+  record->magic = k_reflection_magic;
+  record->version = k_reflection_version;
+  record->spirv_size = static_cast<uint32_t>(spirv_nbytes);
+  record->spirv_hash = spirv_hash;
+  record->set = set;
+
+  // Counts first, the record has fixed capacity.
+  uint32_t n_bindings = 0;
+  uint32_t n_pc_ranges = 0;
+  if (!parse_spirv(spirv_code,
+                   spirv_nbytes,
+                   nullptr,
+                   &n_bindings,
+                   nullptr,
+                   &n_pc_ranges,
+                   set) ||
+      n_bindings > k_max_reflected_bindings ||
+      n_pc_ranges > k_max_reflected_pc_ranges) {
+    spdlog::error("Shader exceeds the reflection record capacity!");
+    return false;
+  }
+
+  VkDescriptorSetLayoutBinding bindings[k_max_reflected_bindings] = {};
+  parse_spirv(spirv_code,
+              spirv_nbytes,
+              bindings,
+              &record->n_bindings,
+              record->pc_ranges,
+              &record->n_pc_ranges,
+              set);
+  for (uint32_t i = 0; i < record->n_bindings; i++) {
+    record->bindings[i].binding = bindings[i].binding;
+    record->bindings[i].type = bindings[i].descriptorType;
+    record->bindings[i].count = bindings[i].descriptorCount;
+  }
+
+  uint32_t n_constants = 0;
+  if (!parse_spirv_constants(spirv_code, spirv_nbytes, nullptr, &n_constants) ||
+      n_constants > k_max_reflected_constants) {
+    spdlog::error("Shader exceeds the reflection record capacity!");
+    return false;
+  }
+  parse_spirv_constants(
+      spirv_code, spirv_nbytes, record->constant_ids, &record->n_constants);
+
+  return parse_spirv_variables(
+      spirv_code, spirv_nbytes, record->variables, &record->n_variables);
+}
+
+bool valid_reflection(const ReflectionRecord& record) {
+  return record.magic == k_reflection_magic &&
+         record.version == k_reflection_version && record.spirv_size > 0 &&
+         record.spirv_size % sizeof(uint32_t) == 0 &&
+         record.n_bindings <= k_max_reflected_bindings &&
+         record.n_pc_ranges <= k_max_reflected_pc_ranges &&
+         record.n_variables <= k_max_reflected_variables &&
+         record.n_constants <= k_max_reflected_constants;
+}
+
+bool read_reflection(const char* path,
+                     size_t spirv_nbytes,
+                     uint32_t spirv_hash,
+                     uint32_t set,
+                     ReflectionRecord* record) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    return false;
+  }
+
+  const bool read = fread(record, sizeof(ReflectionRecord), 1, file) == 1;
+  fclose(file);
+
+  return read && valid_reflection(*record) &&
+         record->spirv_size == spirv_nbytes &&
+         record->spirv_hash == spirv_hash && record->set == set;
+}
+
+bool write_reflection(const char* path, const ReflectionRecord& record) {
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+
+  const bool written = fwrite(&record, sizeof(record), 1, file) == 1 &&
+                       fflush(file) == 0;
+  fclose(file);
+
+  if (!written) {
+    remove(path);
+  }
+
+  return written;
+}
+
 }  // namespace tsk
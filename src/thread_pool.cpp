@@ -0,0 +1,75 @@
+#include "tskgfx/thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace tsk {
+
+void ThreadPool::start(uint32_t thread_count) {
+  assert(threads.empty() && "Thread pool already started!");
+
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  }
+
+  stopping = false;
+  threads.reserve(thread_count);
+  for (uint32_t i = 0; i < thread_count; i++) {
+    threads.emplace_back(&ThreadPool::run, this);
+  }
+}
+
+void ThreadPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  job_available.notify_all();
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+  assert(!threads.empty() && "Thread pool not started!");
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  job_available.notify_one();
+}
+
+uint32_t ThreadPool::pending() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return static_cast<uint32_t>(jobs.size()) + running;
+}
+
+void ThreadPool::run() {
+  for (;;) {
+    std::function<void()> job;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      job_available.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+      // Queued jobs still run once stopping.
+      if (jobs.empty()) {
+        return;
+      }
+
+      job = std::move(jobs.front());
+      jobs.pop_front();
+      running++;
+    }
+
+    job();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    running--;
+  }
+}
+
+}  // namespace tsk
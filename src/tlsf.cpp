@@ -0,0 +1,220 @@
+#include "tskgfx/tlsf.h"
+
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace tsk {
+
+/// @returns Index of the lowest set bit, value must be non zero.
+static uint32_t lowest_bit(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return index;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+/// @returns Index of the highest set bit, value must be non zero.
+static uint32_t highest_bit(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return index;
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+
+/// @brief Maps a size to the bin holding ranges of that size class.
+static void bin_of(uint64_t size,
+                   uint32_t sl_log,
+                   uint32_t* fl,
+                   uint32_t* sl) {
+  if (size < (1ull << sl_log)) {
+    *fl = 0;
+    *sl = static_cast<uint32_t>(size);
+    return;
+  }
+
+  const uint32_t log = highest_bit(size);
+  *fl = log - sl_log + 1;
+  *sl = static_cast<uint32_t>(size >> (log - sl_log)) ^ (1u << sl_log);
+}
+
+void TlsfAllocator::init(uint64_t size) {
+  assert(size > 0 && "Cannot create empty allocator!");
+
+  nodes.clear();
+  unused_nodes.clear();
+
+  fl_bitmap = 0;
+  for (uint32_t fl = 0; fl < k_fl_count; fl++) {
+    sl_bitmaps[fl] = 0;
+    for (uint32_t sl = 0; sl < k_sl_count; sl++) {
+      free_heads[fl][sl] = k_invalid_node;
+    }
+  }
+
+  total_size = size;
+  total_free = size;
+
+  const uint32_t node = new_node();
+  nodes[node] = {0, size, k_invalid_node, k_invalid_node,
+                 k_invalid_node, k_invalid_node, false};
+  insert_free(node);
+}
+
+TlsfAllocator::Allocation TlsfAllocator::allocate(uint64_t size) {
+  if (size == 0 || size > total_free) {
+    return {};
+  }
+
+  // Round up to the next size class so any range in the bin fits.
+  uint64_t search_size = size;
+  if (search_size >= k_sl_count) {
+    search_size += (1ull << (highest_bit(search_size) - k_sl_log)) - 1;
+  }
+
+  uint32_t fl, sl;
+  bin_of(search_size, k_sl_log, &fl, &sl);
+  if (fl >= k_fl_count) {
+    return {};
+  }
+
+  // Find the smallest non empty bin at or above.
+  uint32_t sl_map = sl_bitmaps[fl] & (~0u << sl);
+  if (sl_map == 0) {
+    const uint64_t fl_map =
+        fl + 1 < 64 ? fl_bitmap & (~0ull << (fl + 1)) : 0;
+    if (fl_map == 0) {
+      return {};
+    }
+
+    fl = lowest_bit(fl_map);
+    sl_map = sl_bitmaps[fl];
+  }
+  sl = lowest_bit(sl_map);
+
+  const uint32_t node = free_heads[fl][sl];
+  remove_free(node);
+
+  // Split off the remainder.
+  if (nodes[node].size > size) {
+    const uint32_t rest = new_node();
+    Node& used = nodes[node];
+
+    nodes[rest] = {used.offset + size, used.size - size, node,
+                   used.next_phys, k_invalid_node, k_invalid_node, false};
+    if (used.next_phys != k_invalid_node) {
+      nodes[used.next_phys].prev_phys = rest;
+    }
+
+    used.next_phys = rest;
+    used.size = size;
+    insert_free(rest);
+  }
+
+  nodes[node].used = true;
+  total_free -= size;
+
+  return {nodes[node].offset, size, node};
+}
+
+void TlsfAllocator::free(const Allocation& allocation) {
+  assert(allocation.valid() && nodes[allocation.node].used &&
+         "Cannot free invalid allocation!");
+
+  uint32_t node = allocation.node;
+  total_free += nodes[node].size;
+  nodes[node].used = false;
+
+  // Merge with the previous range.
+  const uint32_t prev = nodes[node].prev_phys;
+  if (prev != k_invalid_node && !nodes[prev].used) {
+    remove_free(prev);
+
+    nodes[prev].size += nodes[node].size;
+    nodes[prev].next_phys = nodes[node].next_phys;
+    if (nodes[node].next_phys != k_invalid_node) {
+      nodes[nodes[node].next_phys].prev_phys = prev;
+    }
+
+    unused_nodes.push_back(node);
+    node = prev;
+  }
+
+  // Merge with the next range.
+  const uint32_t next = nodes[node].next_phys;
+  if (next != k_invalid_node && !nodes[next].used) {
+    remove_free(next);
+
+    nodes[node].size += nodes[next].size;
+    nodes[node].next_phys = nodes[next].next_phys;
+    if (nodes[next].next_phys != k_invalid_node) {
+      nodes[nodes[next].next_phys].prev_phys = node;
+    }
+
+    unused_nodes.push_back(next);
+  }
+
+  insert_free(node);
+}
+
+uint32_t TlsfAllocator::new_node() {
+  if (!unused_nodes.empty()) {
+    const uint32_t node = unused_nodes.back();
+    unused_nodes.pop_back();
+    return node;
+  }
+
+  nodes.push_back({});
+  return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void TlsfAllocator::insert_free(uint32_t node) {
+  uint32_t fl, sl;
+  bin_of(nodes[node].size, k_sl_log, &fl, &sl);
+
+  const uint32_t head = free_heads[fl][sl];
+  nodes[node].prev_free = k_invalid_node;
+  nodes[node].next_free = head;
+  if (head != k_invalid_node) {
+    nodes[head].prev_free = node;
+  }
+
+  free_heads[fl][sl] = node;
+  fl_bitmap |= 1ull << fl;
+  sl_bitmaps[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::remove_free(uint32_t node) {
+  const Node& n = nodes[node];
+
+  if (n.prev_free != k_invalid_node) {
+    nodes[n.prev_free].next_free = n.next_free;
+  }
+  if (n.next_free != k_invalid_node) {
+    nodes[n.next_free].prev_free = n.prev_free;
+  }
+
+  uint32_t fl, sl;
+  bin_of(n.size, k_sl_log, &fl, &sl);
+  if (free_heads[fl][sl] != node) {
+    return;
+  }
+
+  free_heads[fl][sl] = n.next_free;
+  if (n.next_free == k_invalid_node) {
+    sl_bitmaps[fl] &= ~(1u << sl);
+    if (sl_bitmaps[fl] == 0) {
+      fl_bitmap &= ~(1ull << fl);
+    }
+  }
+}
+
+}  // namespace tsk
@@ -4,8 +4,11 @@
 
 #include <cassert>
 #include <cstring>
+#include <vector>
 
+#include "tskgfx/mesh_opt.h"
 #include "tskgfx/renderer.h"
+#include "tskgfx/vertex_encoding.h"
 
 #ifdef TUSK_DEBUG
 #define TUSK_GFX_ASSERT(x, msg) \
@@ -30,9 +33,14 @@ bool init(const AppConfig& app_config) {
   return s_ctx->init(app_config);
 }
 
+// Data owned until uploaded by the next frame, e.g. encoded vertices.
+static std::vector<std::vector<uint8_t>> s_frame_data;
+
 void frame() {
   s_ctx->submit(&s_frame);
   s_ctx->frame();
+
+  s_frame_data.clear();
 }
 
 void shutdown() {
@@ -42,26 +50,80 @@ void shutdown() {
 
 static TextureHandle th;
 TextureHandle create_texture_2d(const TextureInfo& info) {
+  TextureInfo info_2d = info;
+  info_2d.depth = 1;
+
   th.idx++;
-  s_ctx->create_texture_2d(th, info);
+  s_ctx->create_texture(th, info_2d);
+  return th;
+}
+
+TextureHandle create_texture_3d(const TextureInfo& info) {
+  TUSK_GFX_ASSERT(info.num_layers <= 1 && !info.cube_map,
+                  "3D textures cannot be arrays or cube maps!");
+  TUSK_GFX_ASSERT(info.depth > 1, "3D textures must be deeper than 1!");
+
+  th.idx++;
+  s_ctx->create_texture(th, info);
   return th;
 }
 
 void update(TextureHandle th, uint32_t offset, uint32_t size, void* data) {
-  s_ctx->update_texture_2d(th, offset, size, data);
+  TUSK_GFX_ASSERT(offset == 0, "Partial texture updates are not supported!");
+
+  s_ctx->update_texture(th, offset, size, data);
+}
+
+void update_layers(TextureHandle th,
+                   uint16_t first_layer,
+                   uint16_t num_layers,
+                   void* data) {
+  TUSK_GFX_ASSERT(th.idx != k_invalid_handle,
+                  "Cannot update invalid texture handle!");
+  TUSK_GFX_ASSERT(data != nullptr && num_layers > 0,
+                  "Data must be non null and non zero layers!");
+
+  s_ctx->update_texture_layers(th, first_layer, num_layers, data);
 }
 
 void destroy(TextureHandle th) {
   s_ctx->destroy(th);
 }
 
+void request_texture_lod(TextureHandle th, float lod) {
+  TUSK_GFX_ASSERT(th.idx != k_invalid_handle,
+                  "Cannot request lod of invalid texture handle!");
+
+  s_ctx->request_texture_lod(th, lod);
+}
+
+void request_texture_size(TextureHandle th, float screen_size) {
+  TUSK_GFX_ASSERT(th.idx != k_invalid_handle,
+                  "Cannot request size of invalid texture handle!");
+
+  s_ctx->request_texture_size(th, screen_size);
+}
+
+void set_texture_budget(uint64_t bytes) {
+  s_ctx->set_texture_budget(bytes);
+}
+
+TextureStreamingStats get_texture_streaming_stats() {
+  return s_ctx->get_texture_streaming_stats();
+}
+
 static ShaderHandle sh;
 ShaderHandle create_shader(const char* path) {
-  sh.idx++;
+  // The handle is only taken if no identical shader is loaded.
+  ShaderHandle next = sh;
+  next.idx++;
 
-  s_ctx->create_shader(sh, path);
+  ShaderHandle shader = s_ctx->create_shader(next, path);
+  if (shader.idx == next.idx) {
+    sh = next;
+  }
 
-  return sh;
+  return shader;
 }
 
 void destroy(ShaderHandle sh) {
@@ -89,16 +151,96 @@ TUSK_API void destroy(ProgramHandle ph) {
   s_ctx->destroy(ph);
 }
 
+bool is_ready(ProgramHandle ph) {
+  return s_ctx->is_ready(ph);
+}
+
+void set_fallback_program(ProgramHandle ph) {
+  s_ctx->set_fallback_program(ph);
+}
+
+ProgramHandle create_program_variant(ProgramHandle base,
+                                     const SpecializationConstant* constants,
+                                     uint32_t count) {
+  // The handle is only taken if no cached variant is returned.
+  ProgramHandle next = ph;
+  next.idx++;
+
+  ProgramHandle variant =
+      s_ctx->create_program_variant(next, base, constants, count);
+  if (variant.idx == next.idx) {
+    ph = next;
+  }
+
+  return variant;
+}
+
+uint32_t get_specialization_constants(ProgramHandle ph, uint32_t* ids) {
+  return s_ctx->get_specialization_constants(ph, ids);
+}
+
 static DescriptorHandle dh;
 DescriptorHandle create_descriptor(const char* name,
                                    DescriptorType type,
                                    uint16_t rh) {
   dh.idx++;
-  s_ctx->create_descriptor(dh, type, rh, name);
+  s_ctx->create_descriptor(dh, type, rh, SamplerInfo{}, name);
+  return dh;
+}
+
+DescriptorHandle create_descriptor(const char* name,
+                                   TextureHandle th,
+                                   const SamplerInfo& sampler) {
+  dh.idx++;
+  s_ctx->create_descriptor(
+      dh, DescriptorType::k_combined_image_sampler, th, sampler, name);
   return dh;
 }
 
-TUSK_API void destroy(DescriptorHandle dh) {}
+uint32_t get_bindless_sampler(const SamplerInfo& sampler) {
+  return s_ctx->get_bindless_sampler(sampler);
+}
+
+TUSK_API void destroy(DescriptorHandle dh) {
+  TUSK_GFX_ASSERT(dh.idx != k_invalid_handle,
+                  "Cannot destroy invalid descriptor handle!");
+
+  s_ctx->destroy(dh);
+}
+
+static VertexLayoutHandle vlh;
+static VertexEncoding s_vertex_encodings[512] = {};
+VertexLayoutHandle create_vertex_layout(VertexEncoding encoding) {
+  vlh.idx++;
+
+  s_vertex_encodings[vlh] = encoding;
+  return vlh;
+}
+
+/// @brief Encodes vertex data of a layout.
+///
+/// @param[in, out] size Size in bytes of the data, set to the encoded size.
+/// @returns The encoded data, valid until the next frame.
+static void* encode(VertexLayoutHandle vlh, const void* data, uint32_t* size) {
+  const VertexEncoding encoding = vlh.idx != k_invalid_handle
+                                      ? s_vertex_encodings[vlh]
+                                      : VertexEncoding::k_raw;
+  if (encoding == VertexEncoding::k_raw) {
+    return const_cast<void*>(data);
+  }
+
+  TUSK_GFX_ASSERT(*size % sizeof(Vertex) == 0,
+                  "Encoded vertex data must be an array of Vertex!");
+
+  const uint32_t vertex_count = *size / sizeof(Vertex);
+  std::vector<uint8_t>& encoded = s_frame_data.emplace_back(
+      encoded_vertices_size(encoding, vertex_count));
+  encode_vertices(
+      encoding, static_cast<const Vertex*>(data), vertex_count, encoded.data());
+
+  *size = static_cast<uint32_t>(encoded.size());
+  return encoded.data();
+}
 
 static BufferHandle bh;
 BufferHandle create_uniform_buffer(uint32_t size, void* data) {
@@ -115,6 +257,8 @@ BufferHandle create_vertex_buffer(VertexLayoutHandle vlh,
                                   void* data) {
   bh.idx++;
 
+  data = encode(vlh, data, &size);
+
   s_ctx->create_vertex_buffer(bh, vlh, size, data);
   s_ctx->update_buffer(bh, 0, size, data);
 
@@ -146,6 +290,159 @@ void destroy(BufferHandle bh) {
   s_ctx->destroy(bh);
 }
 
+/// @brief Removes duplicate vertices and reorders the mesh for the vertex
+/// cache, overdraw and vertex fetch.
+///
+/// @param[in, out] vertices Vertex array, set to the optimized copy.
+/// @param[in, out] indices Indices, set to the optimized copy.
+static void optimize(const void** vertices,
+                     uint32_t* vertices_size,
+                     const uint32_t** indices,
+                     uint32_t index_count) {
+  const uint32_t vertex_count = *vertices_size / sizeof(Vertex);
+  const VertexCacheStats before =
+      analyze_vertex_cache(*indices, index_count, vertex_count);
+
+  std::vector<uint32_t> remap(vertex_count);
+  const uint32_t unique_count = generate_vertex_remap(
+      remap.data(), *vertices, vertex_count, sizeof(Vertex));
+
+  std::vector<Vertex> unique_vertices(unique_count);
+  remap_vertices(unique_vertices.data(),
+                 *vertices,
+                 vertex_count,
+                 sizeof(Vertex),
+                 remap.data());
+
+  std::vector<uint8_t>& optimized_indices =
+      s_frame_data.emplace_back(index_count * sizeof(uint32_t));
+  uint32_t* out_indices = reinterpret_cast<uint32_t*>(optimized_indices.data());
+  remap_indices(out_indices, *indices, index_count, remap.data());
+
+  optimize_vertex_cache(out_indices, out_indices, index_count, unique_count);
+  optimize_overdraw(out_indices,
+                    out_indices,
+                    index_count,
+                    unique_vertices[0].position,
+                    unique_count,
+                    sizeof(Vertex),
+                    1.05f);
+
+  std::vector<uint8_t>& optimized_vertices =
+      s_frame_data.emplace_back(unique_count * sizeof(Vertex));
+  const uint32_t fetched_count = optimize_vertex_fetch(optimized_vertices.data(),
+                                                       out_indices,
+                                                       index_count,
+                                                       unique_vertices.data(),
+                                                       unique_count,
+                                                       sizeof(Vertex));
+
+  const VertexCacheStats after =
+      analyze_vertex_cache(out_indices, index_count, fetched_count);
+  spdlog::debug(
+      "Optimized mesh, vertices {} -> {}, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} "
+      "-> {:.3f}.",
+      vertex_count,
+      fetched_count,
+      before.acmr,
+      after.acmr,
+      before.atvr,
+      after.atvr);
+
+  *vertices = optimized_vertices.data();
+  *vertices_size = fetched_count * sizeof(Vertex);
+  *indices = out_indices;
+}
+
+static MeshHandle mh;
+MeshHandle create_mesh(VertexLayoutHandle vlh,
+                       const void* vertices,
+                       uint32_t vertices_size,
+                       const uint32_t* indices,
+                       uint32_t index_count,
+                       bool optimize_mesh) {
+  TUSK_GFX_ASSERT(vertices != nullptr && vertices_size > 0,
+                  "Mesh vertices must be non null and non zero size!");
+  TUSK_GFX_ASSERT(indices != nullptr && index_count > 0,
+                  "Mesh indices must be non null and non zero count!");
+
+  mh.idx++;
+
+  if (optimize_mesh) {
+    TUSK_GFX_ASSERT(vlh.idx != k_invalid_handle &&
+                        s_vertex_encodings[vlh] != VertexEncoding::k_raw,
+                    "Optimizing a mesh requires Vertex data!");
+    TUSK_GFX_ASSERT(index_count % 3 == 0, "Mesh indices must form triangles!");
+
+    optimize(&vertices, &vertices_size, &indices, index_count);
+  }
+
+  vertices = encode(vlh, vertices, &vertices_size);
+
+  // The handle is reused by the next mesh if the arenas are full.
+  if (!s_ctx->create_mesh(mh, vertices, vertices_size, indices, index_count)) {
+    mh.idx--;
+    return TUSK_INVALID_HANDLE;
+  }
+
+  return mh;
+}
+
+void destroy(MeshHandle mh) {
+  TUSK_GFX_ASSERT(mh.idx != k_invalid_handle,
+                  "Cannot destroy invalid mesh handle!");
+
+  s_ctx->destroy(mh);
+}
+
+void set_name(BufferHandle bh, const char* name) {
+  TUSK_GFX_ASSERT(bh.idx != k_invalid_handle,
+                  "Cannot name invalid buffer handle!");
+
+  s_ctx->set_name(bh, name);
+}
+
+void set_name(TextureHandle th, const char* name) {
+  TUSK_GFX_ASSERT(th.idx != k_invalid_handle,
+                  "Cannot name invalid texture handle!");
+
+  s_ctx->set_name(th, name);
+}
+
+MemoryStats get_memory_stats() {
+  return s_ctx->get_memory_stats();
+}
+
+uint32_t get_resource_memory(ResourceMemoryInfo* infos, uint32_t max_infos) {
+  return s_ctx->get_resource_memory(infos, max_infos);
+}
+
+void set_memory_warning_callback(MemoryWarningFn fn, float threshold) {
+  s_ctx->set_memory_warning_callback(fn, threshold);
+}
+
+void defragment(uint64_t max_bytes_per_frame,
+                uint32_t max_moves_per_frame,
+                float max_ms_per_frame) {
+  s_ctx->defragment(max_bytes_per_frame, max_moves_per_frame, max_ms_per_frame);
+}
+
+DefragmentationStats get_defragmentation_stats() {
+  return s_ctx->get_defragmentation_stats();
+}
+
+DescriptorCacheStats get_descriptor_cache_stats() {
+  return s_ctx->get_descriptor_cache_stats();
+}
+
+bool save_pipeline_cache() {
+  return s_ctx->save_pipeline_cache();
+}
+
+PipelineCacheStats get_pipeline_cache_stats() {
+  return s_ctx->get_pipeline_cache_stats();
+}
+
 void set_view_proj(const void* mtx) {
   memcpy(
       s_frame.draws[s_frame.draw_count].viewproj_mtx, mtx, sizeof(float) * 16);
@@ -183,6 +480,34 @@ void set_index_buffer(BufferHandle ibh) {
   s_frame.draws[s_frame.draw_count].ibh = ibh;
 }
 
+void set_mesh(MeshHandle mh) {
+  TUSK_GFX_ASSERT(s_frame.draws[s_frame.draw_count].mh.idx == k_invalid_handle,
+                  "Mesh already set for this draw call!");
+
+  TUSK_GFX_ASSERT(mh != k_invalid_handle, "Attemping to set invalid mesh!");
+
+  s_frame.draws[s_frame.draw_count].mh = mh;
+}
+
+void set_uniform(const void* data, uint32_t size) {
+  TUSK_GFX_ASSERT(data != nullptr && size > 0 && size <= k_max_uniform_size,
+                  "Uniform data must be non null and within max size!");
+
+  // Dynamic offsets must be aligned to the device's offset alignment.
+  const uint32_t offset = (s_frame.uniform_size + k_uniform_alignment - 1) &
+                          ~(k_uniform_alignment - 1);
+  if (offset > k_max_frame_uniform_bytes ||
+      size > k_max_frame_uniform_bytes - offset) {
+    spdlog::error("Exceeded max uniform bytes this frame, dropping uniform.");
+    return;
+  }
+
+  memcpy(s_frame.uniform_data + offset, data, size);
+  s_frame.uniform_size = offset + size;
+
+  s_frame.draws[s_frame.draw_count].uniform_offset = offset;
+}
+
 void set_descriptor(DescriptorHandle dh) {
   TUSK_GFX_ASSERT(dh != k_invalid_handle,
                   "Attemping to bind invalid descriptor!");
@@ -191,6 +516,10 @@ void set_descriptor(DescriptorHandle dh) {
   draw.dhs[draw.dh_count++] = dh;
 }
 
+void set_state(const RenderState& state) {
+  s_frame.draws[s_frame.draw_count].state = state;
+}
+
 void submit(ProgramHandle ph) {
   if (ph.idx == tsk::k_invalid_handle) {
     spdlog::error("Calling submit with invalid (ProgramHandle).");
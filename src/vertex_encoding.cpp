@@ -0,0 +1,224 @@
+#include "tskgfx/vertex_encoding.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TUSK_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace tsk {
+
+uint16_t float_to_half(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const uint32_t abs = bits & 0x7fffffff;
+
+  // NaN and infinity, overflow rounds to infinity.
+  if (abs >= 0x7f800000) {
+    return static_cast<uint16_t>(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0));
+  }
+  if (abs >= 0x477ff000) {
+    return static_cast<uint16_t>(sign | 0x7c00);
+  }
+
+  // Subnormal halfs, the float add aligns and rounds the mantissa.
+  if (abs < 0x38800000) {
+    float f;
+    const uint32_t abs_bits = abs;
+    memcpy(&f, &abs_bits, sizeof(f));
+    f += 0.5f;
+
+    uint32_t rounded;
+    memcpy(&rounded, &f, sizeof(rounded));
+    return static_cast<uint16_t>(sign | (rounded - 0x3f000000));
+  }
+
+  // Normal halfs, rebias the exponent and round to nearest even.
+  const uint32_t odd = (abs >> 13) & 1;
+  const uint32_t rebiased = abs + 0xc8000fff + odd;
+  return static_cast<uint16_t>(sign | (rebiased >> 13));
+}
+
+/// @brief Computes the bounds of vertex positions.
+static void position_bounds(const Vertex* vertices,
+                            uint32_t vertex_count,
+                            float* min,
+                            float* max) {
+  for (int c = 0; c < 3; c++) {
+    min[c] = vertex_count > 0 ? vertices[0].position[c] : 0.0f;
+    max[c] = min[c];
+  }
+
+  for (uint32_t i = 1; i < vertex_count; i++) {
+    for (int c = 0; c < 3; c++) {
+      min[c] = std::min(min[c], vertices[i].position[c]);
+      max[c] = std::max(max[c], vertices[i].position[c]);
+    }
+  }
+}
+
+#ifndef TUSK_SSE2
+/// @brief Projects a unit normal on the octahedron and unfolds the lower
+/// hemisphere.
+static void octahedral(const float* n, float* oct) {
+  const float sum = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+  const float inv_sum = sum > 0.0f ? 1.0f / sum : 0.0f;
+
+  float x = n[0] * inv_sum;
+  float y = n[1] * inv_sum;
+
+  if (n[2] < 0.0f) {
+    const float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    const float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = fx;
+    y = fy;
+  }
+
+  oct[0] = x;
+  oct[1] = y;
+}
+
+static void encode_compressed_scalar(const Vertex* vertices,
+                                     uint32_t vertex_count,
+                                     const float* offset,
+                                     const float* inv_scale,
+                                     CompressedVertex* dst) {
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    const Vertex& v = vertices[i];
+    CompressedVertex& out = dst[i];
+
+    for (int c = 0; c < 3; c++) {
+      const float unorm = (v.position[c] - offset[c]) * inv_scale[c];
+      out.position[c] = static_cast<uint16_t>(
+          std::clamp(unorm, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+    out.position[3] = 0;
+
+    float oct[2];
+    octahedral(v.normal, oct);
+    for (int c = 0; c < 2; c++) {
+      out.normal[c] = static_cast<int16_t>(
+          std::lround(std::clamp(oct[c], -1.0f, 1.0f) * 32767.0f));
+    }
+
+    out.uv[0] = float_to_half(v.uv[0]);
+    out.uv[1] = float_to_half(v.uv[1]);
+  }
+}
+
+#else
+/// @brief Encodes positions and normals with SSE2, half conversion stays
+/// scalar as SSE2 has no conversion instruction.
+static void encode_compressed_sse2(const Vertex* vertices,
+                                   uint32_t vertex_count,
+                                   const float* offset,
+                                   const float* inv_scale,
+                                   CompressedVertex* dst) {
+  // The 4th lane of positions loads normal x, a zero scale clears it.
+  const __m128 offset4 = _mm_setr_ps(offset[0], offset[1], offset[2], 0.0f);
+  const __m128 scale4 = _mm_setr_ps(inv_scale[0] * 65535.0f,
+                                    inv_scale[1] * 65535.0f,
+                                    inv_scale[2] * 65535.0f,
+                                    0.0f);
+  const __m128 unorm_max = _mm_set1_ps(65535.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 snorm_max = _mm_set1_ps(32767.0f);
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128i bias = _mm_set1_epi32(32768);
+  const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    const Vertex& v = vertices[i];
+    CompressedVertex& out = dst[i];
+
+    // Position, packs saturate signed so the range is biased around zero.
+    __m128 p = _mm_loadu_ps(v.position);
+    p = _mm_mul_ps(_mm_sub_ps(p, offset4), scale4);
+    p = _mm_min_ps(_mm_max_ps(p, zero), unorm_max);
+    __m128i q = _mm_cvttps_epi32(_mm_add_ps(p, half));
+    q = _mm_sub_epi32(q, bias);
+    q = _mm_xor_si128(_mm_packs_epi32(q, q), bias16);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out.position), q);
+
+    // Normal, (x, y, z, uv) with the uv lane masked out of the sum.
+    __m128 n = _mm_loadu_ps(v.normal);
+    const __m128 abs_n = _mm_andnot_ps(sign_mask, n);
+    const float sum = _mm_cvtss_f32(abs_n) +
+                      _mm_cvtss_f32(_mm_shuffle_ps(abs_n, abs_n, 1)) +
+                      _mm_cvtss_f32(_mm_shuffle_ps(abs_n, abs_n, 2));
+    n = _mm_mul_ps(n, _mm_set1_ps(sum > 0.0f ? 1.0f / sum : 0.0f));
+
+    if (v.normal[2] < 0.0f) {
+      // (1 - |yx|) * sign(xy)
+      const __m128 yx = _mm_shuffle_ps(n, n, _MM_SHUFFLE(3, 2, 0, 1));
+      const __m128 folded =
+          _mm_sub_ps(one, _mm_andnot_ps(sign_mask, yx));
+      n = _mm_or_ps(folded, _mm_and_ps(n, sign_mask));
+    }
+
+    n = _mm_min_ps(_mm_max_ps(n, _mm_sub_ps(zero, one)), one);
+    __m128i o = _mm_cvtps_epi32(_mm_mul_ps(n, snorm_max));
+    o = _mm_packs_epi32(o, o);
+    const int32_t packed_normal = _mm_cvtsi128_si32(o);
+    memcpy(out.normal, &packed_normal, sizeof(out.normal));
+
+    out.uv[0] = float_to_half(v.uv[0]);
+    out.uv[1] = float_to_half(v.uv[1]);
+  }
+}
+#endif
+
+size_t encoded_vertices_size(VertexEncoding encoding, uint32_t vertex_count) {
+  switch (encoding) {
+    case VertexEncoding::k_compressed:
+      return sizeof(VertexEncodingHeader) +
+             size_t(vertex_count) * sizeof(CompressedVertex);
+
+    default:
+      return size_t(vertex_count) * sizeof(Vertex);
+  }
+}
+
+void encode_vertices(VertexEncoding encoding,
+                     const Vertex* vertices,
+                     uint32_t vertex_count,
+                     void* dst) {
+  if (encoding != VertexEncoding::k_compressed) {
+    memcpy(dst, vertices, size_t(vertex_count) * sizeof(Vertex));
+    return;
+  }
+
+  float min[3], max[3];
+  position_bounds(vertices, vertex_count, min, max);
+
+  VertexEncodingHeader header = {};
+  float inv_scale[3];
+  for (int c = 0; c < 3; c++) {
+    header.offset[c] = min[c];
+    header.scale[c] = max[c] - min[c];
+    inv_scale[c] = header.scale[c] > 0.0f ? 1.0f / header.scale[c] : 0.0f;
+  }
+
+  memcpy(dst, &header, sizeof(header));
+
+  CompressedVertex* out = reinterpret_cast<CompressedVertex*>(
+      static_cast<uint8_t*>(dst) + sizeof(header));
+
+#ifdef TUSK_SSE2
+  encode_compressed_sse2(vertices, vertex_count, header.offset, inv_scale, out);
+#else
+  encode_compressed_scalar(
+      vertices, vertex_count, header.offset, inv_scale, out);
+#endif
+}
+
+}  // namespace tsk